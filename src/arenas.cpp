@@ -0,0 +1,646 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "args.h"
+#include "arenas.h"
+#include "map.h"
+#include "memory.h"
+#include "pagemap.h"
+
+// glibc keeps these in private headers. All values are for 64 bit targets.
+static const std::size_t FastbinCount = 10;
+static const std::size_t BinCount = 128;
+static const std::size_t BinmapBytes = 16;
+static const std::size_t ChunkHeaderSize = 16;
+static const std::size_t MinChunkSize = 32;
+// Non-main arenas grow in heaps of at most this size, aligned to it, so that
+// a chunk finds its heap by masking its address.
+static const std::uintptr_t HeapMaxSize = 64 * 1024 * 1024;
+// Chunks this large may be allocated with mmap(), with no arena.
+static const std::size_t MmapThresholdMin = 128 * 1024;
+
+// Low bits of the size field of a chunk.
+static const std::uint64_t PrevInUse = 1;
+static const std::uint64_t IsMmapped = 2;
+static const std::uint64_t SizeFlags = 7;
+
+// Walking more than this many arenas, heaps, or links of a fastbin, means
+// that we are following garbage.
+static const std::size_t MaxArenas = 4096;
+static const std::size_t MaxHeaps = 1 << 16;
+static const std::size_t MaxLinks = 1 << 20;
+
+// Bytes read per pread() while walking a heap.
+static const std::size_t WindowSize = 1024 * 1024;
+
+// Enough of malloc_state that an empty arena gets recognized by it.
+static const std::size_t MinEmptyBins = 64;
+
+// Offsets into malloc_state. glibc 2.27 added have_fastchunks in front of
+// fastbinsY, which moves everything after it by 8 bytes.
+struct ArenaLayout
+{
+	std::size_t bins;
+
+	inline std::size_t Fastbins() const
+	{
+		return Top() - FastbinCount * 8;
+	}
+
+	inline std::size_t Top() const
+	{
+		// top and last_remainder.
+		return bins - 16;
+	}
+
+	inline std::size_t Next() const
+	{
+		return bins + (BinCount * 2 - 2) * 8 + BinmapBytes;
+	}
+
+	inline std::size_t SystemMem() const
+	{
+		// After next, next_free and attached_threads.
+		return Next() + 3 * 8;
+	}
+
+	inline std::size_t Size() const
+	{
+		// system_mem and max_system_mem.
+		return SystemMem() + 2 * 8;
+	}
+};
+
+static const ArenaLayout Layouts[] = { { 112 }, { 104 } };
+
+// A chunk that might be in a fastbin: in use, as far as the heap says.
+struct FastChunk
+{
+	std::uint64_t fd;
+	std::size_t size;
+	VmmapEntry* entry;
+};
+
+static inline std::uint64_t Word(const char* data, std::size_t offset)
+{
+	std::uint64_t word;
+	memcpy(&word, data + offset, sizeof(word));
+	return word;
+}
+
+static inline std::uintptr_t AlignUp(std::uintptr_t address, std::uintptr_t alignment)
+{
+	return (address + alignment - 1) & ~(alignment - 1);
+}
+
+// An empty bin links to itself, as a fake chunk whose fd is the bin.
+static std::size_t CountEmptyBins(const char* state, std::uintptr_t address, const ArenaLayout& layout)
+{
+	std::size_t empty = 0;
+	for (std::size_t bin = 0; bin < BinCount - 1; ++bin)
+	{
+		std::uint64_t self = address + layout.bins + bin * 16 - 16;
+		empty += Word(state, layout.bins + bin * 16) == self && Word(state, layout.bins + bin * 16 + 8) == self;
+	}
+	return empty;
+}
+
+// Whether a malloc_state could be at address. The bins alone also match at
+// a multiple of 16 bytes off, so next and system_mem must make sense, too.
+static std::size_t ArenaScore(const char* state, std::uintptr_t address, const ArenaLayout& layout)
+{
+	std::uint64_t next = Word(state, layout.Next());
+	std::uint64_t systemMem = Word(state, layout.SystemMem());
+	if (next == 0 || next % 16 != 0 || (next != address && next > address && next < address + layout.Size())
+		|| systemMem % PagemapPageSize() != 0)
+	{
+		return 0;
+	}
+
+	return CountEmptyBins(state, address, layout);
+}
+
+// The address of main_arena in the symbol table of libc, relative to where
+// it is loaded. Distributions usually strip the symbol table, then this
+// returns 0.
+static std::uintptr_t FindMainArenaSymbol(const std::string& path)
+{
+	struct ElfHeader
+	{
+		unsigned char ident[16];
+		std::uint16_t type;
+		std::uint16_t machine;
+		std::uint32_t version;
+		std::uint64_t entry;
+		std::uint64_t phoff;
+		std::uint64_t shoff;
+		std::uint32_t flags;
+		std::uint16_t ehsize;
+		std::uint16_t phentsize;
+		std::uint16_t phnum;
+		std::uint16_t shentsize;
+		std::uint16_t shnum;
+		std::uint16_t shstrndx;
+	};
+
+	struct ElfSection
+	{
+		std::uint32_t name;
+		std::uint32_t type;
+		std::uint64_t flags;
+		std::uint64_t addr;
+		std::uint64_t offset;
+		std::uint64_t size;
+		std::uint32_t link;
+		std::uint32_t info;
+		std::uint64_t addralign;
+		std::uint64_t entsize;
+	};
+
+	struct ElfSymbol
+	{
+		std::uint32_t name;
+		unsigned char info;
+		unsigned char other;
+		std::uint16_t shndx;
+		std::uint64_t value;
+		std::uint64_t size;
+	};
+
+	const std::uint32_t SectionSymtab = 2;
+	const unsigned char Class64 = 2;
+
+	std::ifstream file(path, std::ios::binary);
+	ElfHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || memcmp(header.ident, "\x7f" "ELF", 4) != 0 || header.ident[4] != Class64
+		|| header.shentsize != sizeof(ElfSection))
+	{
+		return 0;
+	}
+
+	std::vector<ElfSection> sections(header.shnum);
+	file.seekg(header.shoff);
+	if (!file.read((char*)sections.data(), sections.size() * sizeof(ElfSection)))
+	{
+		return 0;
+	}
+
+	for (const auto& section : sections)
+	{
+		if (section.type != SectionSymtab || section.link >= sections.size())
+		{
+			continue;
+		}
+
+		std::vector<ElfSymbol> symbols(section.size / sizeof(ElfSymbol));
+		std::string names(sections[section.link].size, '\0');
+		file.seekg(section.offset);
+		file.read((char*)symbols.data(), symbols.size() * sizeof(ElfSymbol));
+		file.seekg(sections[section.link].offset);
+		file.read(&names[0], names.size());
+		if (!file)
+		{
+			return 0;
+		}
+
+		for (const auto& symbol : symbols)
+		{
+			if (symbol.name < names.size() && strcmp(names.c_str() + symbol.name, "main_arena") == 0)
+			{
+				return symbol.value;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static bool IsLibc(const VmmapEntry& entry)
+{
+	std::size_t slash = entry.regionDetail.rfind('/');
+	if (entry.inode == 0 || slash == std::string::npos)
+	{
+		return false;
+	}
+
+	// libc.so.6, or libc-2.31.so before glibc 2.34.
+	std::string name = entry.regionDetail.substr(slash + 1);
+	return name.compare(0, 7, "libc.so") == 0 || (name.compare(0, 5, "libc-") == 0 && name.size() > 5 && isdigit(name[5]));
+}
+
+// Finds main_arena, and which layout of malloc_state the libc uses.
+static std::uintptr_t FindMainArena(MemoryReader& reader, const std::list<VmmapEntry>& entries, ArenaLayout& layout)
+{
+	const VmmapEntry* base = nullptr;
+	std::vector<const VmmapEntry*> data;
+	for (const auto& entry : entries)
+	{
+		if (!IsLibc(entry))
+		{
+			continue;
+		}
+		if (entry.offset == 0 && base == nullptr)
+		{
+			base = &entry;
+		}
+		if (entry.prt == "rw-")
+		{
+			data.push_back(&entry);
+		}
+	}
+
+	if (base == nullptr)
+	{
+		return 0;
+	}
+
+	std::vector<char> state(Layouts[0].Size());
+	std::uintptr_t best = 0;
+	std::size_t bestScore = MinEmptyBins - 1;
+	auto consider = [&](std::uintptr_t address)
+	{
+		for (const auto& candidate : Layouts)
+		{
+			std::size_t score = ArenaScore(state.data(), address, candidate);
+			if (score > bestScore)
+			{
+				best = address;
+				bestScore = score;
+				layout = candidate;
+			}
+		}
+	};
+
+	// Shared objects are linked at 0, so symbols are relative to the start
+	// of the first mapping.
+	std::uintptr_t symbol = FindMainArenaSymbol(base->regionDetail);
+	if (symbol != 0)
+	{
+		std::uintptr_t address = base->startAddress + symbol;
+		if (reader.ReadPresent(address, state.data(), state.size()) == state.size())
+		{
+			consider(address);
+			if (best != 0)
+			{
+				return best;
+			}
+		}
+	}
+
+	// Without symbols, look for the bins in the data of libc, and take the
+	// best match. main_arena is initialized, so it is in .data rather than .bss.
+	for (const VmmapEntry* entry : data)
+	{
+		std::vector<char> buffer(entry->vsize);
+		std::size_t read = reader.ReadPresent(entry->startAddress, buffer.data(), buffer.size());
+
+		for (std::size_t offset = 0; offset + state.size() <= read; offset += 8)
+		{
+			// Cheap test first: the first bin that is normally empty.
+			std::uintptr_t address = entry->startAddress + offset;
+			std::size_t lastBin = (BinCount - 2) * 16;
+			bool candidate = false;
+			for (const auto& option : Layouts)
+			{
+				std::uint64_t self = address + option.bins + lastBin - 16;
+				candidate = candidate || Word(buffer.data(), offset + option.bins + lastBin) == self;
+			}
+			if (!candidate)
+			{
+				continue;
+			}
+
+			memcpy(state.data(), buffer.data() + offset, state.size());
+			consider(address);
+		}
+	}
+
+	return best;
+}
+
+static VmmapEntry* FindEntry(std::vector<VmmapEntry*>& regions, std::uintptr_t address)
+{
+	auto it = std::upper_bound(regions.begin(), regions.end(), address, [](std::uintptr_t address, const VmmapEntry* entry)
+	{
+		return address < (std::uintptr_t)entry->startAddress;
+	});
+	if (it == regions.begin() || address >= (std::uintptr_t)(*(it - 1))->endAddress)
+	{
+		return nullptr;
+	}
+	return *(it - 1);
+}
+
+// Reads a heap through a window of WindowSize bytes, so that walking it
+// takes one pread() per window rather than one per chunk.
+struct HeapWindow
+{
+	MemoryReader& reader;
+	std::vector<char> buffer;
+	std::uintptr_t start = 0;
+	std::size_t size = 0;
+
+	HeapWindow(MemoryReader& reader)
+		: reader(reader), buffer(WindowSize)
+	{
+	}
+
+	bool Word(std::uintptr_t address, std::uint64_t& word)
+	{
+		if (address < start || address + sizeof(word) > start + size)
+		{
+			start = address & ~(std::uintptr_t)(PagemapPageSize() - 1);
+			size = reader.ReadPresent(start, buffer.data(), buffer.size());
+			if (address + sizeof(word) > start + size)
+			{
+				return false;
+			}
+		}
+
+		memcpy(&word, buffer.data() + (address - start), sizeof(word));
+		return true;
+	}
+};
+
+// Walks the chunks from start to end, or to the top chunk, counting the
+// ones in use into the region they are in.
+// A chunk is in use if the next one has PREV_INUSE. Fastbin chunks keep it,
+// so those that might be are remembered, to be taken out again later.
+static void WalkHeap(HeapWindow& window, std::vector<VmmapEntry*>& regions, std::uintptr_t start, std::uintptr_t end, std::uintptr_t top,
+	std::size_t maxFastSize, std::unordered_map<std::uintptr_t, FastChunk>& fastChunks)
+{
+	std::uintptr_t previous = 0;
+	std::size_t previousSize = 0;
+	std::uint64_t previousFd = 0;
+
+	for (std::uintptr_t chunk = start; chunk + ChunkHeaderSize <= end; )
+	{
+		std::uint64_t sizeField;
+		if (!window.Word(chunk + 8, sizeField))
+		{
+			return;
+		}
+
+		if (previous != 0 && (sizeField & PrevInUse))
+		{
+			VmmapEntry* entry = FindEntry(regions, previous);
+			if (entry != nullptr)
+			{
+				++entry->mallocCount;
+				entry->mallocBytes += previousSize - 8;
+			}
+			if (previousSize <= maxFastSize)
+			{
+				fastChunks[previous] = { previousFd, previousSize, entry };
+			}
+		}
+
+		std::size_t size = sizeField & ~SizeFlags;
+		// The top chunk is the free rest of the heap. Heaps that are not the
+		// top one end in fenceposts, which are smaller than any chunk. And
+		// the process may have changed the heap under us.
+		if (chunk == top || size < MinChunkSize || chunk + size > end)
+		{
+			return;
+		}
+
+		previous = chunk;
+		previousSize = size;
+		if (size <= maxFastSize && !window.Word(chunk + ChunkHeaderSize, previousFd))
+		{
+			return;
+		}
+
+		chunk += size;
+	}
+}
+
+// Takes the chunks in the fastbins of an arena out of the counts.
+// Since glibc 2.32, fd pointers are mangled with the address they are stored at.
+static void RemoveFastbins(const char* state, const ArenaLayout& layout, std::unordered_map<std::uintptr_t, FastChunk>& fastChunks)
+{
+	for (std::size_t bin = 0; bin < FastbinCount; ++bin)
+	{
+		std::uintptr_t chunk = Word(state, layout.Fastbins() + bin * 8);
+		for (std::size_t links = 0; chunk != 0 && links < MaxLinks; ++links)
+		{
+			auto it = fastChunks.find(chunk);
+			if (it == fastChunks.end())
+			{
+				break;
+			}
+
+			FastChunk& fast = it->second;
+			if (fast.entry != nullptr && fast.entry->mallocCount != 0)
+			{
+				--fast.entry->mallocCount;
+				fast.entry->mallocBytes -= fast.size - 8;
+			}
+
+			std::uintptr_t raw = fast.fd;
+			std::uintptr_t demangled = fast.fd ^ ((chunk + ChunkHeaderSize) >> 12);
+			fastChunks.erase(it);
+
+			if (raw == 0 || demangled == 0)
+			{
+				break;
+			}
+			chunk = fastChunks.count(raw) ? raw : demangled;
+		}
+	}
+}
+
+static void MarkZone(VmmapEntry& entry, const std::string& zone)
+{
+	entry.regionType = "MALLOC";
+	entry.regionDetail = zone;
+	entry.mallocWalked = true;
+}
+
+static std::string ZoneName(const std::string& prefix, std::uintptr_t address)
+{
+	std::ostringstream ss;
+	ss << prefix << "_0x" << std::hex << address;
+	return ss.str();
+}
+
+bool WalkArenas(const VmmapArgs& args, std::list<VmmapEntry>& entries)
+{
+	MemoryReader reader(args.pid, args.scanRate * 1024 * 1024);
+	if (!reader.IsOpen())
+	{
+		return false;
+	}
+
+	std::vector<VmmapEntry*> regions;
+	for (auto& entry : entries)
+	{
+		regions.push_back(&entry);
+	}
+
+	ArenaLayout layout = Layouts[0];
+	std::uintptr_t mainArena = FindMainArena(reader, entries, layout);
+	HeapWindow window(reader);
+	std::vector<char> state(layout.Size());
+
+	// The arenas form a ring, starting at main_arena.
+	std::uintptr_t arena = mainArena;
+	for (std::size_t arenas = 0; arena != 0 && arenas < MaxArenas; ++arenas)
+	{
+		if (reader.ReadPresent(arena, state.data(), state.size()) != state.size() || ArenaScore(state.data(), arena, layout) == 0)
+		{
+			break;
+		}
+
+		std::uintptr_t top = Word(state.data(), layout.Top());
+		// global_max_fast is 128 bytes of request by default, chunks of up to
+		// 144 bytes; we do not know if it was changed, so take the maximum.
+		std::size_t maxFastSize = (FastbinCount + 1) * 16;
+		std::unordered_map<std::uintptr_t, FastChunk> fastChunks;
+
+		if (arena == mainArena)
+		{
+			// The brk heap, which grows up from the start of [heap]. It may be
+			// split into several regions, by mprotect() or differing flags, and
+			// only the first one starts with a chunk.
+			std::string zone = ZoneName("main_arena", arena);
+			std::uintptr_t heapStart = 0;
+			std::uintptr_t heapEnd = 0;
+			for (auto& entry : entries)
+			{
+				if (entry.regionDetail != "[heap]" || (heapStart != 0 && (std::uintptr_t)entry.startAddress != heapEnd))
+				{
+					continue;
+				}
+				if (heapStart == 0)
+				{
+					heapStart = entry.startAddress;
+				}
+				heapEnd = entry.endAddress;
+				MarkZone(entry, zone);
+			}
+			if (heapStart != 0)
+			{
+				WalkHeap(window, regions, AlignUp(heapStart, 16), heapEnd, top, maxFastSize, fastChunks);
+			}
+		}
+		else
+		{
+			// The first heap of an arena holds the arena, right after its
+			// heap_info. Later heaps link back to it through prev.
+			std::string zone = ZoneName("arena", arena);
+			std::uintptr_t firstHeap = arena & ~(HeapMaxSize - 1);
+			std::size_t heapInfoSize = arena - firstHeap;
+			std::uintptr_t heap = top & ~(HeapMaxSize - 1);
+
+			for (std::size_t heaps = 0; heap != 0 && heaps < MaxHeaps; ++heaps)
+			{
+				// ar_ptr, prev, size.
+				std::uint64_t info[3];
+				if (reader.ReadPresent(heap, info, sizeof(info)) != sizeof(info) || info[0] != arena)
+				{
+					break;
+				}
+
+				std::uintptr_t start = (heap == firstHeap) ? AlignUp(arena + layout.Size(), 16) : AlignUp(heap + heapInfoSize, 16);
+				WalkHeap(window, regions, start, heap + info[2], top, maxFastSize, fastChunks);
+
+				VmmapEntry* headerEntry = FindEntry(regions, heap);
+				if (headerEntry != nullptr)
+				{
+					headerEntry->mallocHeaderBytes += start - heap;
+				}
+
+				// The rest of the heap is reserved, but not accessible yet.
+				for (VmmapEntry* entry : regions)
+				{
+					if ((std::uintptr_t)entry->startAddress >= heap && (std::uintptr_t)entry->endAddress <= heap + HeapMaxSize)
+					{
+						MarkZone(*entry, zone);
+					}
+				}
+
+				heap = info[1];
+			}
+		}
+
+		RemoveFastbins(state.data(), layout, fastChunks);
+
+		arena = Word(state.data(), layout.Next());
+		if (arena == mainArena)
+		{
+			break;
+		}
+	}
+
+	if (mainArena == 0)
+	{
+		return true;
+	}
+
+	// Chunks allocated with mmap() are alone in their mapping, unless the
+	// kernel merged neighbouring ones into one region. They start with a
+	// prev_size of 0 and IS_MMAPPED.
+	for (VmmapEntry* entry : regions)
+	{
+		if (entry->regionType != "VM_ALLOCATE" || entry->prt != "rw-" || entry->sharedMapping || entry->inode != 0 || entry->vsize < MmapThresholdMin)
+		{
+			continue;
+		}
+
+		std::uintptr_t chunk = entry->startAddress;
+		while (chunk + ChunkHeaderSize <= (std::uintptr_t)entry->endAddress)
+		{
+			std::uint64_t header[2];
+			if (reader.ReadPresent(chunk, header, sizeof(header)) != sizeof(header) || header[0] != 0 || (header[1] & SizeFlags) != IsMmapped)
+			{
+				break;
+			}
+
+			std::size_t size = header[1] & ~SizeFlags;
+			if (size < MmapThresholdMin || chunk + size > (std::uintptr_t)entry->endAddress)
+			{
+				break;
+			}
+
+			if (!entry->mallocWalked)
+			{
+				MarkZone(*entry, "mmap_chunks");
+			}
+			++entry->mallocCount;
+			entry->mallocBytes += size - ChunkHeaderSize;
+			chunk += size;
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_ARENAS_H__
+#define VMMAP_ARENAS_H__
+
+#include <list>
+
+struct VmmapArgs;
+struct VmmapEntry;
+
+// Walks the glibc malloc arenas of the process: main_arena, found through
+// the symbol table of libc or else by its empty bins, and all arenas linked
+// from it. Every heap of an arena is read in large batches, chunk header by
+// chunk header, and the regions holding it become MALLOC regions, with the
+// arena as the detail, and their in-use chunks counted into
+// VmmapEntry::mallocCount and mallocBytes. Chunks allocated with mmap()
+// become a zone of their own.
+// Only present pages are read, so nothing is swapped in or faulted in. A
+// heap walk stops at its first page that is not present.
+// Processes without glibc malloc are left untouched.
+// Returns false if the memory of the process cannot be read.
+bool WalkArenas(const VmmapArgs& args, std::list<VmmapEntry>& entries);
+
+#endif
\ No newline at end of file
@@ -26,6 +26,16 @@
 
 #include "args.h"
 
+static std::size_t ParseNumber(const std::string& option, const std::string& value)
+{
+	if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos)
+	{
+		throw std::invalid_argument("[invalid usage]: " + option + " needs a number, not \'" + value + "\'");
+	}
+
+	return std::stoull(value);
+}
+
 VmmapArgs ParseArgs(int argc, char** argv)
 {
 	VmmapArgs vmmapArgs;
@@ -80,6 +90,138 @@ VmmapArgs ParseArgs(int argc, char** argv)
 		{
 			vmmapArgs.forkCorpse = true;
 		}
+		else if (arg == "-preciseSharing")
+		{
+			vmmapArgs.preciseSharing = true;
+		}
+		else if (arg == "-zeropages")
+		{
+			vmmapArgs.zeroPages = true;
+		}
+		else if (arg == "-duplicates")
+		{
+			vmmapArgs.duplicates = true;
+		}
+		else if (arg == "-compressibility")
+		{
+			vmmapArgs.compressibility = true;
+		}
+		else if (arg == "-workingset")
+		{
+			if (i + 1 >= argc)
+			{
+				throw std::invalid_argument("[invalid usage]: -workingset needs a number of seconds");
+			}
+			vmmapArgs.workingSetSeconds = ParseNumber(arg, argv[++i]);
+			if (vmmapArgs.workingSetSeconds == 0)
+			{
+				throw std::invalid_argument("[invalid usage]: -workingset needs at least one second");
+			}
+		}
+		else if (arg == "-damon")
+		{
+			if (i + 1 >= argc)
+			{
+				throw std::invalid_argument("[invalid usage]: -damon needs a number of seconds");
+			}
+			vmmapArgs.damonSeconds = ParseNumber(arg, argv[++i]);
+			if (vmmapArgs.damonSeconds == 0)
+			{
+				throw std::invalid_argument("[invalid usage]: -damon needs at least one second");
+			}
+		}
+		else if (arg == "-writes")
+		{
+			if (i + 1 >= argc)
+			{
+				throw std::invalid_argument("[invalid usage]: -writes needs a number of seconds");
+			}
+			vmmapArgs.writeSeconds = ParseNumber(arg, argv[++i]);
+			if (vmmapArgs.writeSeconds == 0)
+			{
+				throw std::invalid_argument("[invalid usage]: -writes needs at least one second");
+			}
+		}
+		else if (arg == "-hugepages")
+		{
+			vmmapArgs.hugePages = true;
+		}
+		else if (arg == "-numa")
+		{
+			vmmapArgs.numa = true;
+		}
+		else if (arg == "-pagecache")
+		{
+			vmmapArgs.pageCache = true;
+		}
+		else if (arg == "-text")
+		{
+			vmmapArgs.text = true;
+		}
+		else if (arg == "-swap")
+		{
+			vmmapArgs.swapDevices = true;
+		}
+		else if (arg == "-ksm")
+		{
+			vmmapArgs.ksm = true;
+		}
+		else if (arg == "-commit")
+		{
+			vmmapArgs.commit = true;
+		}
+		else if (arg == "-pagetables")
+		{
+			vmmapArgs.pageTables = true;
+		}
+		else if (arg == "-pss")
+		{
+			vmmapArgs.pss = true;
+		}
+		else if (arg == "-threadstacks")
+		{
+			vmmapArgs.threadStacks = true;
+		}
+		else if (arg == "-fragmentation")
+		{
+			vmmapArgs.fragmentation = true;
+		}
+		else if (arg == "-arenas")
+		{
+			vmmapArgs.arenas = true;
+		}
+		else if (arg == "-faults")
+		{
+			if (i + 1 >= argc)
+			{
+				throw std::invalid_argument("[invalid usage]: -faults needs a number of seconds");
+			}
+			vmmapArgs.faultSeconds = ParseNumber(arg, argv[++i]);
+			if (vmmapArgs.faultSeconds == 0)
+			{
+				throw std::invalid_argument("[invalid usage]: -faults needs at least one second");
+			}
+		}
+		else if (arg == "-faultInterval")
+		{
+			if (i + 1 >= argc)
+			{
+				throw std::invalid_argument("[invalid usage]: -faultInterval needs a number of milliseconds");
+			}
+			vmmapArgs.faultInterval = ParseNumber(arg, argv[++i]);
+			if (vmmapArgs.faultInterval == 0)
+			{
+				throw std::invalid_argument("[invalid usage]: -faultInterval needs at least one millisecond");
+			}
+		}
+		else if (arg == "-scanRate")
+		{
+			if (i + 1 >= argc)
+			{
+				throw std::invalid_argument("[invalid usage]: -scanRate needs a rate in MB/s");
+			}
+			vmmapArgs.scanRate = ParseNumber(arg, argv[++i]);
+		}
 		else if (arg[0] != '-')
 		{
 			// To do: Support search by process name.
@@ -91,7 +233,7 @@ VmmapArgs ParseArgs(int argc, char** argv)
 				}
 			}
 
-			vmmapArgs.pid = std::stoi(arg);
+			vmmapArgs.pids.push_back(std::stoi(arg));
 		}
 		else
 		{
@@ -99,10 +241,12 @@ VmmapArgs ParseArgs(int argc, char** argv)
 		}
 	}
 
-	if (vmmapArgs.pid == -1)
+	if (vmmapArgs.pids.empty())
 	{
 		throw std::invalid_argument("[invalid usage]: no process specified");
 	}
 
+	vmmapArgs.pid = vmmapArgs.pids.front();
+
 	return vmmapArgs;
 }
\ No newline at end of file
@@ -23,9 +23,13 @@
 #ifndef VMMAP_ARGS_H__
 #define VMMAP_ARGS_H__
 
+#include <vector>
+
 struct VmmapArgs
 {
 	int pid = -1;
+	// All processes given on the command line, pid is the first one.
+	std::vector<int> pids;
 	bool wide = false;
 	bool pages = false;
 	bool interleaved = false;
@@ -36,6 +40,39 @@ struct VmmapArgs
 	bool stacks = false;
 	bool fullStacks = false;
 	bool forkCorpse = false;
+	bool preciseSharing = false;
+	bool zeroPages = false;
+	bool duplicates = false;
+	bool compressibility = false;
+	bool hugePages = false;
+	bool numa = false;
+	bool pageCache = false;
+	bool text = false;
+	bool swapDevices = false;
+	bool ksm = false;
+	bool commit = false;
+	bool pageTables = false;
+	bool pss = false;
+	bool threadStacks = false;
+	bool fragmentation = false;
+	bool arenas = false;
+
+	// With -workingset, how long to watch for accesses. 0 leaves it off.
+	std::size_t workingSetSeconds = 0;
+
+	// With -damon, how long DAMON monitors the process. 0 leaves it off.
+	std::size_t damonSeconds = 0;
+
+	// With -writes, how long to watch for writes. 0 leaves it off.
+	std::size_t writeSeconds = 0;
+
+	// With -faults, how long to watch for page faults. 0 leaves it off.
+	std::size_t faultSeconds = 0;
+	// How often the pagemap is sampled meanwhile, in milliseconds.
+	std::size_t faultInterval = 1000;
+
+	// Cap for analyses that read the memory of the target, in MB/s.
+	std::size_t scanRate = 256;
 };
 
 VmmapArgs ParseArgs(int argc, char** argv);
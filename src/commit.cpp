@@ -0,0 +1,76 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <sstream>
+#include <string>
+
+#include "commit.h"
+#include "snapshot.h"
+
+VmmapCommitLimits ParseCommitLimits(const VmmapSnapshot& snapshot)
+{
+	VmmapCommitLimits limits;
+
+	std::istringstream meminfo(snapshot.meminfo.Contents());
+	std::string line;
+	while (std::getline(meminfo, line))
+	{
+		std::istringstream fields(line);
+		std::string name;
+		std::size_t kilobytes;
+		if (!(fields >> name >> kilobytes))
+		{
+			continue;
+		}
+
+		if (name == "CommitLimit:")
+		{
+			limits.commitLimit = kilobytes * 1024;
+		}
+		else if (name == "Committed_AS:")
+		{
+			limits.committed = kilobytes * 1024;
+		}
+	}
+
+	std::istringstream overcommit(snapshot.overcommitMemory.Contents());
+	overcommit >> limits.overcommitMode;
+
+	// "Max locked memory         8388608              8388608              bytes"
+	std::istringstream processLimits(snapshot.limits.Contents());
+	while (std::getline(processLimits, line))
+	{
+		if (line.compare(0, 17, "Max locked memory") == 0)
+		{
+			std::istringstream fields(line.substr(17));
+			std::string soft;
+			fields >> soft;
+			if (soft != "unlimited")
+			{
+				limits.memlockLimit = std::stoull(soft);
+			}
+			break;
+		}
+	}
+
+	return limits;
+}
\ No newline at end of file
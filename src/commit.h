@@ -0,0 +1,47 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_COMMIT_H__
+#define VMMAP_COMMIT_H__
+
+#include <cstddef>
+#include <cstdint>
+
+struct VmmapSnapshot;
+
+// System wide commit accounting, and the memory locking limit of one process.
+struct VmmapCommitLimits
+{
+	// From /proc/meminfo, in bytes.
+	std::size_t commitLimit = 0;
+	std::size_t committed = 0;
+	// /proc/sys/vm/overcommit_memory: 0 heuristic, 1 always, 2 strict.
+	int overcommitMode = 0;
+
+	// RLIMIT_MEMLOCK of the process, SIZE_MAX if unlimited.
+	std::size_t memlockLimit = SIZE_MAX;
+};
+
+// From the meminfo, overcommit_memory and limits files of the snapshot.
+VmmapCommitLimits ParseCommitLimits(const VmmapSnapshot& snapshot);
+
+#endif
\ No newline at end of file
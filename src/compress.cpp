@@ -0,0 +1,288 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "args.h"
+#include "compress.h"
+#include "map.h"
+#include "memory.h"
+#include "pagemap.h"
+#include "parallel.h"
+
+// Samples needed to estimate a ratio in [0, 1] within 5% at 95% confidence,
+// for an infinite population: (1.96 * 0.5 / 0.05)^2.
+static const double BaseSamples = 384.16;
+
+// Pages read per pread(), per thread. Samples are mostly isolated pages anyway.
+static const std::size_t ReadPages = 16;
+
+// LZ4 block format parameters.
+static const std::size_t MinMatch = 4;
+static const std::size_t LastLiterals = 5;
+static const std::size_t MaxOffset = 65535;
+static const int HashLog = 12;
+
+static inline std::uint32_t Load32(const char* data)
+{
+	std::uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+// Bytes needed to encode a length in an LZ4 token plus extension bytes.
+static inline std::size_t LengthBytes(std::size_t length)
+{
+	return (length >= 15) ? (length - 15) / 255 + 1 : 0;
+}
+
+static bool IsSameFilled(const char* page, std::size_t size)
+{
+	std::uint64_t first;
+	memcpy(&first, page, sizeof(first));
+
+	for (std::size_t i = sizeof(first); i + sizeof(first) <= size; i += sizeof(first))
+	{
+		std::uint64_t word;
+		memcpy(&word, page + i, sizeof(word));
+		if (word != first)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::size_t CompressedPageSize(const char* page, std::size_t size)
+{
+	if (IsSameFilled(page, size))
+	{
+		return 0;
+	}
+
+	// Greedy LZ4: only the output size is computed, nothing is written.
+	std::uint32_t table[1 << HashLog] = {};
+
+	std::size_t out = 0;
+	std::size_t anchor = 0;
+	std::size_t i = 0;
+
+	while (i + MinMatch + LastLiterals <= size)
+	{
+		std::uint32_t sequence = Load32(page + i);
+		std::size_t hash = (sequence * 2654435761u) >> (32 - HashLog);
+
+		// Positions are stored plus one, 0 means empty.
+		std::size_t candidate = table[hash];
+		table[hash] = (std::uint32_t)(i + 1);
+
+		if (candidate != 0 && i - (candidate - 1) <= MaxOffset && Load32(page + candidate - 1) == sequence)
+		{
+			std::size_t match = candidate - 1;
+			std::size_t length = MinMatch;
+			while (i + length < size - LastLiterals && page[match + length] == page[i + length])
+			{
+				++length;
+			}
+
+			std::size_t literals = i - anchor;
+			out += 1 + LengthBytes(literals) + literals + 2 + LengthBytes(length - MinMatch);
+
+			i += length;
+			anchor = i;
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	std::size_t literals = size - anchor;
+	out += 1 + LengthBytes(literals) + literals;
+
+	// zram keeps incompressible pages as they are.
+	return std::min(out, size);
+}
+
+// Running sums of the sampled ratios of a region.
+struct SampleSums
+{
+	std::size_t count = 0;
+	double sum = 0;
+	double squares = 0;
+};
+
+bool EstimateCompressibility(const VmmapArgs& args, std::list<VmmapEntry>& entries)
+{
+	MemoryReader reader(args.pid, args.scanRate * 1024 * 1024);
+	if (!reader.IsOpen())
+	{
+		return false;
+	}
+
+	const std::size_t pageSize = PagemapPageSize();
+
+	std::vector<VmmapEntry*> regions;
+	std::vector<const VmmapEntry*> constRegions;
+	for (auto& entry : entries)
+	{
+		regions.push_back(&entry);
+		constRegions.push_back(&entry);
+	}
+
+	// First, count the candidates, to size the samples.
+	// Exclusive anonymous pages only: zram holds neither file pages nor the
+	// shared zero page, and swapping out a page still COW-shared after fork
+	// frees nothing.
+	const std::uint64_t candidateMask = PagemapPresent | PagemapExclusive | PagemapFile;
+	const std::uint64_t candidate = PagemapPresent | PagemapExclusive;
+	std::vector<std::atomic<std::size_t>> population(regions.size());
+	for (auto& count : population)
+	{
+		count = 0;
+	}
+
+	bool result = WalkPagemap(args.pid, constRegions, [&](const PagemapBatch& batch)
+	{
+		std::size_t count = 0;
+		for (std::size_t i = 0; i < batch.count; ++i)
+		{
+			count += (batch.entries[i] & candidateMask) == candidate;
+		}
+		population[batch.region] += count;
+	});
+
+	if (!result)
+	{
+		return false;
+	}
+
+	// Each candidate is then sampled with the same probability, which needs no
+	// coordination between the threads walking different parts of a region.
+	std::vector<double> probability(regions.size());
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		double count = population[i];
+		// Finite population correction, so small regions are not oversampled.
+		double samples = BaseSamples / (1 + (BaseSamples - 1) / std::max(count, 1.0));
+		probability[i] = std::min(1.0, samples / std::max(count, 1.0));
+	}
+
+	std::vector<std::vector<SampleSums>> sums(WorkerCount(), std::vector<SampleSums>(regions.size()));
+	std::vector<std::vector<char>> buffers(WorkerCount());
+	std::vector<std::vector<std::uint64_t>> selections(WorkerCount());
+	std::vector<std::mt19937_64> generators;
+
+	std::random_device seed;
+	for (unsigned worker = 0; worker < WorkerCount(); ++worker)
+	{
+		generators.emplace_back(((std::uint64_t)seed() << 32) | seed());
+	}
+
+	result = WalkPagemap(args.pid, constRegions, [&](const PagemapBatch& batch)
+	{
+		std::vector<char>& buffer = buffers[batch.worker];
+		std::vector<std::uint64_t>& selection = selections[batch.worker];
+		std::mt19937_64& generator = generators[batch.worker];
+		SampleSums& regionSums = sums[batch.worker][batch.region];
+
+		if (buffer.empty())
+		{
+			buffer.resize(ReadPages * pageSize);
+		}
+
+		std::bernoulli_distribution pick(probability[batch.region]);
+
+		// Keep the picked entries, clear the others, and let ReadPages() do the rest.
+		selection.assign(batch.entries, batch.entries + batch.count);
+		bool any = false;
+		for (auto& entry : selection)
+		{
+			if ((entry & candidateMask) == candidate && pick(generator))
+			{
+				any = true;
+			}
+			else
+			{
+				entry = 0;
+			}
+		}
+
+		if (!any)
+		{
+			return;
+		}
+
+		PagemapBatch sampled = batch;
+		sampled.entries = selection.data();
+
+		reader.ReadPages(regions[batch.region]->startAddress, sampled, candidate, 0, buffer, [&](std::size_t, const char* data)
+		{
+			double ratio = CompressedPageSize(data, pageSize) / (double)pageSize;
+			++regionSums.count;
+			regionSums.sum += ratio;
+			regionSums.squares += ratio * ratio;
+		});
+	});
+
+	if (!result)
+	{
+		return false;
+	}
+
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		SampleSums total;
+		for (const auto& workerSums : sums)
+		{
+			total.count += workerSums[i].count;
+			total.sum += workerSums[i].sum;
+			total.squares += workerSums[i].squares;
+		}
+
+		VmmapEntry& region = *regions[i];
+		region.compressiblePages = population[i];
+		region.compressionSamples = total.count;
+
+		if (total.count == 0)
+		{
+			continue;
+		}
+
+		double bytes = (double)region.compressiblePages * pageSize;
+		double mean = total.sum / total.count;
+		double variance = (total.count > 1) ? (total.squares - total.count * mean * mean) / (total.count - 1) : 0;
+		double correction = std::max(0.0, 1 - (double)total.count / region.compressiblePages);
+
+		region.compressedBytes = bytes * mean;
+		region.compressedVariance = bytes * bytes * std::max(0.0, variance) / total.count * correction;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_COMPRESS_H__
+#define VMMAP_COMPRESS_H__
+
+#include <cstddef>
+#include <list>
+
+struct VmmapEntry;
+struct VmmapArgs;
+
+// Size of the page once compressed with an LZ4-style compressor, as zram would
+// store it: pages filled with one repeated word cost nothing, pages that do not
+// compress are stored as they are.
+std::size_t CompressedPageSize(const char* page, std::size_t size);
+
+// Compresses a random sample of the exclusively mapped anonymous pages of
+// every region, and fills VmmapEntry::compressiblePages, compressionSamples,
+// compressedBytes and compressedVariance.
+// The sample is sized so that the compression ratio of each region is known
+// within about 5% at 95% confidence, whatever the size of the region.
+// Returns false if the memory of the process cannot be read.
+bool EstimateCompressibility(const VmmapArgs& args, std::list<VmmapEntry>& entries);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,369 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "damon.h"
+#include "debug.h"
+#include "map.h"
+
+// Sampling and aggregation intervals, the DAMON defaults. A region accessed
+// in every sample of an aggregation interval has AggregationUs / SampleUs
+// accesses.
+static const std::uint64_t SampleUs = 5000;
+static const std::uint64_t AggregationUs = 100000;
+static const std::uint64_t UpdateUs = 1000000;
+static const std::uint64_t MaxAccesses = AggregationUs / SampleUs;
+
+static const int MinRegions = 10;
+static const int MaxRegions = 1000;
+
+// DAMON regions move every aggregation interval, so the access counts are
+// summed over a fixed grid of cells instead. A cell is 2M, or larger for huge
+// regions, so that no region has more than MaxCellsPerEntry.
+static const std::size_t CellBytes = 2 * 1024 * 1024;
+static const std::size_t MaxCellsPerEntry = 4096;
+
+static const int CleanupSignals[] = { SIGINT, SIGTERM, SIGHUP };
+
+// Open while our kdamond exists, so that a signal handler can stop it.
+static int damonStateFd = -1;
+static int damonCountFd = -1;
+
+struct DamonRegion
+{
+	std::uintptr_t start;
+	std::uintptr_t end;
+	std::uint64_t accesses;
+};
+
+// Access counts of one VmmapEntry over the whole monitoring window.
+struct HeatCells
+{
+	std::size_t cellBytes = CellBytes;
+	// Sum over all aggregation intervals of the nr_accesses of the DAMON
+	// regions overlapping the cell, weighted by how much of it they cover.
+	std::vector<double> accesses;
+	// False for cells that no DAMON region ever covered.
+	std::vector<bool> covered;
+};
+
+static std::string DamonRoot()
+{
+	return SystemPrefix + "/sys/kernel/mm/damon/admin/kdamonds";
+}
+
+static bool WriteSysfs(const std::string& path, const std::string& value)
+{
+	int fd = open(path.c_str(), O_WRONLY);
+	if (fd < 0)
+	{
+		DEBUG_PRINT("Failed to open " << path);
+		return false;
+	}
+
+	bool result = write(fd, value.c_str(), value.size()) == (ssize_t)value.size();
+	close(fd);
+
+	if (!result)
+	{
+		DEBUG_PRINT("Failed to write " << value << " to " << path);
+	}
+	return result;
+}
+
+static bool ReadSysfs(const std::string& path, std::uint64_t& value)
+{
+	std::ifstream file(path);
+	return (bool)(file >> value);
+}
+
+// Only async-signal-safe calls in here.
+static void StopDamon()
+{
+	if (damonStateFd >= 0)
+	{
+		ssize_t ignored = pwrite(damonStateFd, "off", 3, 0);
+		(void)ignored;
+	}
+	if (damonCountFd >= 0)
+	{
+		ssize_t ignored = pwrite(damonCountFd, "0", 1, 0);
+		(void)ignored;
+	}
+}
+
+static void OnCleanupSignal(int signal)
+{
+	StopDamon();
+	std::signal(signal, SIG_DFL);
+	raise(signal);
+}
+
+// Owns the kdamond from its creation on. It is the only kdamond, because
+// writing nr_kdamonds would tear down any other one.
+struct DamonSession
+{
+	void (*previousHandlers[sizeof(CleanupSignals) / sizeof(CleanupSignals[0])])(int);
+
+	DamonSession()
+	{
+		damonCountFd = open((DamonRoot() + "/nr_kdamonds").c_str(), O_WRONLY);
+
+		for (std::size_t i = 0; i < sizeof(CleanupSignals) / sizeof(CleanupSignals[0]); ++i)
+		{
+			previousHandlers[i] = std::signal(CleanupSignals[i], OnCleanupSignal);
+		}
+	}
+
+	~DamonSession()
+	{
+		StopDamon();
+
+		for (std::size_t i = 0; i < sizeof(CleanupSignals) / sizeof(CleanupSignals[0]); ++i)
+		{
+			std::signal(CleanupSignals[i], previousHandlers[i]);
+		}
+
+		if (damonStateFd >= 0)
+		{
+			close(damonStateFd);
+		}
+		if (damonCountFd >= 0)
+		{
+			close(damonCountFd);
+		}
+		damonStateFd = damonCountFd = -1;
+	}
+};
+
+static bool Configure(const std::string& kdamond, int pid)
+{
+	std::string context = kdamond + "/contexts/0";
+	std::string attrs = context + "/monitoring_attrs";
+	std::string scheme = context + "/schemes/0";
+	std::string pattern = scheme + "/access_pattern";
+
+	// A "stat" scheme matching everything does nothing but lets us read the
+	// regions it was tried on back, with their access counts.
+	return WriteSysfs(kdamond + "/contexts/nr_contexts", "1")
+		&& WriteSysfs(context + "/operations", "vaddr")
+		&& WriteSysfs(attrs + "/intervals/sample_us", std::to_string(SampleUs))
+		&& WriteSysfs(attrs + "/intervals/aggr_us", std::to_string(AggregationUs))
+		&& WriteSysfs(attrs + "/intervals/update_us", std::to_string(UpdateUs))
+		&& WriteSysfs(attrs + "/nr_regions/min", std::to_string(MinRegions))
+		&& WriteSysfs(attrs + "/nr_regions/max", std::to_string(MaxRegions))
+		&& WriteSysfs(context + "/targets/nr_targets", "1")
+		&& WriteSysfs(context + "/targets/0/pid_target", std::to_string(pid))
+		&& WriteSysfs(context + "/schemes/nr_schemes", "1")
+		&& WriteSysfs(scheme + "/action", "stat")
+		&& WriteSysfs(pattern + "/sz/min", "0")
+		&& WriteSysfs(pattern + "/sz/max", std::to_string(UINTPTR_MAX))
+		&& WriteSysfs(pattern + "/nr_accesses/min", "0")
+		&& WriteSysfs(pattern + "/nr_accesses/max", std::to_string(UINT32_MAX))
+		&& WriteSysfs(pattern + "/age/min", "0")
+		&& WriteSysfs(pattern + "/age/max", std::to_string(UINT32_MAX));
+}
+
+static bool ReadRegions(const std::string& kdamond, std::vector<DamonRegion>& regions)
+{
+	std::string directory = kdamond + "/contexts/0/schemes/0/tried_regions";
+
+	DIR* dir = opendir(directory.c_str());
+	if (dir == nullptr)
+	{
+		return false;
+	}
+
+	std::vector<std::string> names;
+	while (dirent* item = readdir(dir))
+	{
+		if (isdigit(item->d_name[0]))
+		{
+			names.push_back(item->d_name);
+		}
+	}
+	closedir(dir);
+
+	for (const auto& name : names)
+	{
+		std::string path = directory + "/" + name;
+		std::uint64_t start, end, accesses;
+		if (!ReadSysfs(path + "/start", start) || !ReadSysfs(path + "/end", end) || !ReadSysfs(path + "/nr_accesses", accesses))
+		{
+			return false;
+		}
+		regions.push_back({ (std::uintptr_t)start, (std::uintptr_t)end, accesses });
+	}
+
+	std::sort(regions.begin(), regions.end(), [](const DamonRegion& a, const DamonRegion& b)
+	{
+		return a.start < b.start;
+	});
+
+	return true;
+}
+
+// Both lists are sorted by address, and DAMON regions do not overlap, so one
+// pass over each is enough.
+static void AccumulateRegions(const std::vector<DamonRegion>& regions, const std::list<VmmapEntry>& entries, std::vector<HeatCells>& heat)
+{
+	auto region = regions.begin();
+	std::size_t index = 0;
+
+	for (const auto& entry : entries)
+	{
+		HeatCells& cells = heat[index++];
+
+		for (std::size_t cell = 0; cell < cells.accesses.size(); ++cell)
+		{
+			std::uintptr_t start = entry.startAddress + cell * cells.cellBytes;
+			std::uintptr_t end = std::min<std::uintptr_t>(start + cells.cellBytes, entry.endAddress);
+
+			while (region != regions.end() && region->end <= start)
+			{
+				++region;
+			}
+
+			for (auto overlap = region; overlap != regions.end() && overlap->start < end; ++overlap)
+			{
+				std::size_t bytes = std::min(end, overlap->end) - std::max(start, overlap->start);
+				cells.accesses[cell] += overlap->accesses * (double)bytes / (end - start);
+				cells.covered[cell] = true;
+			}
+		}
+	}
+}
+
+static void ClassifyCells(const std::vector<HeatCells>& heat, std::size_t intervals, std::list<VmmapEntry>& entries)
+{
+	double maxAccesses = (double)MaxAccesses * intervals;
+	std::size_t index = 0;
+
+	for (auto& entry : entries)
+	{
+		const HeatCells& cells = heat[index++];
+
+		for (std::size_t cell = 0; cell < cells.accesses.size(); ++cell)
+		{
+			if (!cells.covered[cell])
+			{
+				continue;
+			}
+
+			std::uintptr_t start = entry.startAddress + cell * cells.cellBytes;
+			std::size_t bytes = std::min<std::uintptr_t>(start + cells.cellBytes, entry.endAddress) - start;
+
+			if (cells.accesses[cell] * 2 >= maxAccesses)
+			{
+				entry.hotBytes += bytes;
+			}
+			else if (cells.accesses[cell] > 0)
+			{
+				entry.warmBytes += bytes;
+			}
+			else
+			{
+				entry.coldBytes += bytes;
+			}
+		}
+	}
+}
+
+bool MeasureDamonHeat(const VmmapArgs& args, std::list<VmmapEntry>& entries)
+{
+	std::string root = DamonRoot();
+	std::string kdamond = root + "/0";
+
+	std::uint64_t kdamonds;
+	if (!ReadSysfs(root + "/nr_kdamonds", kdamonds))
+	{
+		DEBUG_PRINT("DAMON sysfs interface is not available.");
+		return false;
+	}
+	if (kdamonds != 0)
+	{
+		DEBUG_PRINT("DAMON is already in use.");
+		return false;
+	}
+
+	DamonSession session;
+	if (damonCountFd < 0 || !WriteSysfs(root + "/nr_kdamonds", "1"))
+	{
+		return false;
+	}
+
+	damonStateFd = open((kdamond + "/state").c_str(), O_WRONLY);
+	if (damonStateFd < 0 || !Configure(kdamond, args.pid) || !WriteSysfs(kdamond + "/state", "on"))
+	{
+		return false;
+	}
+
+	std::vector<HeatCells> heat(entries.size());
+	std::size_t index = 0;
+	for (const auto& entry : entries)
+	{
+		HeatCells& cells = heat[index++];
+		std::size_t size = entry.endAddress - entry.startAddress;
+		while (size / cells.cellBytes >= MaxCellsPerEntry)
+		{
+			cells.cellBytes *= 2;
+		}
+		cells.accesses.resize((size + cells.cellBytes - 1) / cells.cellBytes);
+		cells.covered.resize(cells.accesses.size());
+	}
+
+	// nr_accesses only covers the last aggregation interval, so the regions
+	// are read back after every one of them until the time is up. The update
+	// command returns once the scheme has been applied again, which is at the
+	// end of the next aggregation interval. An interval missed while we were
+	// reading is left out of both the counts and the maximum.
+	std::size_t intervals = 0;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(args.damonSeconds);
+	while (std::chrono::steady_clock::now() < deadline)
+	{
+		std::vector<DamonRegion> regions;
+		if (!WriteSysfs(kdamond + "/state", "update_schemes_tried_regions") || !ReadRegions(kdamond, regions))
+		{
+			return false;
+		}
+
+		AccumulateRegions(regions, entries, heat);
+		++intervals;
+	}
+
+	ClassifyCells(heat, std::max<std::size_t>(intervals, 1), entries);
+	return true;
+}
\ No newline at end of file
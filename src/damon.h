@@ -0,0 +1,41 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_DAMON_H__
+#define VMMAP_DAMON_H__
+
+#include <list>
+
+struct VmmapEntry;
+struct VmmapArgs;
+
+// Monitors the virtual address space of the process with DAMON for
+// args.damonSeconds, through /sys/kernel/mm/damon/admin, and splits every
+// region into VmmapEntry::hotBytes, warmBytes and coldBytes from the access
+// frequency of the DAMON regions overlapping it, summed over every aggregation
+// interval of the window.
+// The kdamond is stopped and removed again on return, or if we are killed
+// by SIGINT, SIGTERM or SIGHUP meanwhile.
+// Returns false if DAMON is not available, or already in use.
+bool MeasureDamonHeat(const VmmapArgs& args, std::list<VmmapEntry>& entries);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,345 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "args.h"
+#include "duplicates.h"
+#include "map.h"
+#include "memory.h"
+#include "pagemap.h"
+#include "parallel.h"
+
+// Up to this many pages, every hash is kept and sorted, which is exact.
+// 8M pages of 4K is 32G of memory and 128M of hashes.
+static const std::size_t ExactPageLimit = 8 * 1024 * 1024;
+
+// Beyond that, two bitmaps of this many bits per resident page (4 bytes per page)
+// pick out the pages that may have a copy. Fewer than 1 in 16 unique pages
+// collide with another page there, and those are weeded out by the exact count.
+static const std::size_t FilterBitsPerPage = 16;
+
+// Pages read per pread(), per thread.
+static const std::size_t ReadPages = 256;
+
+// The accumulate step of XXH3: 32x32->64 bit multiplies over independent lanes,
+// which compilers turn into pmuludq on SSE2 and AVX2.
+static const int HashLanes = 8;
+static const std::uint64_t HashSecret[HashLanes] =
+{
+	0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+	0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull,
+};
+
+static inline std::uint64_t Avalanche(std::uint64_t hash)
+{
+	hash ^= hash >> 37;
+	hash *= 0x165667919e3779f9ull;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+std::uint64_t HashPage(const char* page, std::size_t size)
+{
+	std::uint64_t accumulators[HashLanes];
+	for (int lane = 0; lane < HashLanes; ++lane)
+	{
+		accumulators[lane] = HashSecret[lane];
+	}
+
+	std::size_t i = 0;
+	for (; i + sizeof(std::uint64_t) * HashLanes <= size; i += sizeof(std::uint64_t) * HashLanes)
+	{
+		std::uint64_t data[HashLanes];
+		memcpy(data, page + i, sizeof(data));
+
+		for (int lane = 0; lane < HashLanes; ++lane)
+		{
+			std::uint64_t key = data[lane] ^ HashSecret[lane];
+			accumulators[lane ^ 1] += data[lane];
+			accumulators[lane] += (key & 0xffffffffull) * (key >> 32);
+		}
+	}
+
+	std::uint64_t hash = size * 0x9e3779b185ebca87ull;
+	for (int lane = 0; lane < HashLanes; ++lane)
+	{
+		hash = Avalanche(hash ^ accumulators[lane]) + lane;
+	}
+
+	for (; i < size; ++i)
+	{
+		hash = (hash ^ (unsigned char)page[i]) * 0x100000001b3ull;
+	}
+
+	return Avalanche(hash);
+}
+
+struct PageHash
+{
+	std::uint64_t hash;
+	// Process index << 16 | region type index.
+	std::uint32_t tag;
+
+	inline bool operator<(const PageHash& other) const
+	{
+		return hash < other.hash;
+	}
+};
+
+static inline std::uint32_t MakeTag(std::size_t process, std::size_t type)
+{
+	return (std::uint32_t)(process << 16 | type);
+}
+
+// Reads and hashes every exclusively mapped anonymous page of every process.
+// visit(hash, tag, worker) may run on any thread.
+static bool HashAllPages(const std::vector<VmmapProcess>& processes, const VmmapArgs& args,
+	const std::unordered_map<std::string, std::size_t>& typeIndices,
+	const std::function<void(std::uint64_t hash, std::uint32_t tag, unsigned worker)>& visit)
+{
+	const std::size_t pageSize = PagemapPageSize();
+	std::vector<std::vector<char>> buffers(WorkerCount());
+
+	for (std::size_t process = 0; process < processes.size(); ++process)
+	{
+		MemoryReader reader(processes[process].pid, args.scanRate * 1024 * 1024);
+		if (!reader.IsOpen())
+		{
+			return false;
+		}
+
+		std::vector<const VmmapEntry*> regions;
+		for (const auto& entry : processes[process].entries)
+		{
+			regions.push_back(&entry);
+		}
+
+		bool result = WalkPagemap(processes[process].pid, regions, [&](const PagemapBatch& batch)
+		{
+			std::vector<char>& buffer = buffers[batch.worker];
+			if (buffer.empty())
+			{
+				buffer.resize(ReadPages * pageSize);
+			}
+
+			const VmmapEntry& region = *regions[batch.region];
+			std::uint32_t tag = MakeTag(process, typeIndices.at(region.regionType));
+
+			// Anonymous pages: present, and not backed by a file or shmem. Pages
+			// mapped more than once (the shared zero page, COW pages still shared
+			// after fork, KSM pages) are already merged, so they are skipped.
+			reader.ReadPages(region.startAddress, batch, PagemapPresent | PagemapExclusive, PagemapFile, buffer, [&](std::size_t, const char* data)
+			{
+				visit(HashPage(data, pageSize), tag, batch.worker);
+			});
+		});
+
+		if (!result)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Sorts the hashes, and accounts every page with the number of pages that share its hash.
+static void CountHashes(std::vector<std::vector<PageHash>>& perWorker,
+	const std::function<void(std::uint32_t tag, std::size_t copies, unsigned worker)>& account)
+{
+	std::vector<PageHash> hashes;
+	for (auto& list : perWorker)
+	{
+		hashes.insert(hashes.end(), list.begin(), list.end());
+		std::vector<PageHash>().swap(list);
+	}
+	std::sort(hashes.begin(), hashes.end());
+
+	for (std::size_t i = 0; i < hashes.size(); )
+	{
+		std::size_t end = i;
+		while (end < hashes.size() && hashes[end].hash == hashes[i].hash)
+		{
+			++end;
+		}
+		for (std::size_t j = i; j < end; ++j)
+		{
+			account(hashes[j].tag, end - i, 0);
+		}
+		i = end;
+	}
+}
+
+bool ScanDuplicatePages(const std::vector<VmmapProcess>& processes, const VmmapArgs& args, VmmapDuplicates& duplicates)
+{
+	const std::size_t pageSize = PagemapPageSize();
+
+	std::unordered_map<std::string, std::size_t> typeIndices;
+	std::size_t residentPages = 0;
+
+	duplicates.processes.resize(processes.size());
+	for (std::size_t process = 0; process < processes.size(); ++process)
+	{
+		duplicates.processes[process].name = std::to_string(processes[process].pid);
+		for (const auto& entry : processes[process].entries)
+		{
+			if (!typeIndices.count(entry.regionType))
+			{
+				typeIndices[entry.regionType] = duplicates.regionTypes.size();
+				duplicates.regionTypes.emplace_back();
+				duplicates.regionTypes.back().name = entry.regionType;
+			}
+			residentPages += entry.rss / pageSize;
+		}
+	}
+
+	// Per-thread totals, indexed by tag parts, so the hot path takes no locks.
+	struct Totals
+	{
+		std::vector<std::size_t> typeScanned;
+		std::vector<double> typeDuplicate;
+		std::vector<std::size_t> processScanned;
+		std::vector<double> processDuplicate;
+	};
+	std::vector<Totals> totals(WorkerCount());
+	for (auto& total : totals)
+	{
+		total.typeScanned.resize(duplicates.regionTypes.size());
+		total.typeDuplicate.resize(duplicates.regionTypes.size());
+		total.processScanned.resize(processes.size());
+		total.processDuplicate.resize(processes.size());
+	}
+
+	auto account = [&](std::uint32_t tag, std::size_t copies, unsigned worker)
+	{
+		Totals& total = totals[worker];
+		std::size_t process = tag >> 16;
+		std::size_t type = tag & 0xffff;
+		double duplicate = (copies - 1) / (double)copies;
+
+		total.typeScanned[type] += 1;
+		total.typeDuplicate[type] += duplicate;
+		total.processScanned[process] += 1;
+		total.processDuplicate[process] += duplicate;
+	};
+
+	if (residentPages <= ExactPageLimit)
+	{
+		std::vector<std::vector<PageHash>> perWorker(WorkerCount());
+		bool result = HashAllPages(processes, args, typeIndices, [&](std::uint64_t hash, std::uint32_t tag, unsigned worker)
+		{
+			perWorker[worker].push_back({ hash, tag });
+		});
+		if (!result)
+		{
+			return false;
+		}
+
+		CountHashes(perWorker, account);
+	}
+	else
+	{
+		// Too many pages to keep every hash. A first pass marks every hash as
+		// seen once or seen twice. The second pass keeps only the hashes seen
+		// twice, which are the duplicates plus a few collisions, and counts
+		// them exactly. Twice the reading, in exchange for a few bytes per page.
+		duplicates.twoPass = true;
+
+		std::size_t bits = 64;
+		while (bits < residentPages * FilterBitsPerPage)
+		{
+			bits *= 2;
+		}
+
+		std::unique_ptr<std::atomic<std::uint64_t>[]> seenOnce(new std::atomic<std::uint64_t>[bits / 64]);
+		std::unique_ptr<std::atomic<std::uint64_t>[]> seenTwice(new std::atomic<std::uint64_t>[bits / 64]);
+		for (std::size_t i = 0; i < bits / 64; ++i)
+		{
+			seenOnce[i] = 0;
+			seenTwice[i] = 0;
+		}
+
+		bool result = HashAllPages(processes, args, typeIndices, [&](std::uint64_t hash, std::uint32_t, unsigned)
+		{
+			std::size_t bit = hash & (bits - 1);
+			std::uint64_t mask = 1ull << (bit % 64);
+			if (seenOnce[bit / 64].fetch_or(mask, std::memory_order_relaxed) & mask)
+			{
+				seenTwice[bit / 64].fetch_or(mask, std::memory_order_relaxed);
+			}
+		});
+
+		std::vector<std::vector<PageHash>> perWorker(WorkerCount());
+		result = result && HashAllPages(processes, args, typeIndices, [&](std::uint64_t hash, std::uint32_t tag, unsigned worker)
+		{
+			std::size_t bit = hash & (bits - 1);
+			if (seenTwice[bit / 64].load(std::memory_order_relaxed) & (1ull << (bit % 64)))
+			{
+				perWorker[worker].push_back({ hash, tag });
+			}
+			else
+			{
+				account(tag, 1, worker);
+			}
+		});
+
+		if (!result)
+		{
+			return false;
+		}
+
+		seenOnce.reset();
+		seenTwice.reset();
+		CountHashes(perWorker, account);
+	}
+
+	for (const auto& total : totals)
+	{
+		for (std::size_t i = 0; i < duplicates.regionTypes.size(); ++i)
+		{
+			duplicates.regionTypes[i].scanned += total.typeScanned[i];
+			duplicates.regionTypes[i].duplicate += total.typeDuplicate[i];
+		}
+		for (std::size_t i = 0; i < processes.size(); ++i)
+		{
+			duplicates.processes[i].scanned += total.processScanned[i];
+			duplicates.processes[i].duplicate += total.processDuplicate[i];
+		}
+	}
+
+	for (const auto& row : duplicates.processes)
+	{
+		duplicates.scanned += row.scanned;
+		duplicates.duplicate += row.duplicate;
+	}
+
+	return true;
+}
\ No newline at end of file
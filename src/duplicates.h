@@ -0,0 +1,67 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_DUPLICATES_H__
+#define VMMAP_DUPLICATES_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct VmmapArgs;
+struct VmmapProcess;
+
+// 64 bit hash of a page, vectorizes well with SSE2/AVX2.
+std::uint64_t HashPage(const char* page, std::size_t size);
+
+// Bytes are in pages of PagemapPageSize().
+// A page that exists n times counts (n - 1) / n as a duplicate, so that
+// the duplicates of a group add up to what merging them would reclaim,
+// wherever the copies live.
+struct VmmapDuplicateRow
+{
+	std::string name;
+	std::size_t scanned = 0;
+	double duplicate = 0;
+};
+
+struct VmmapDuplicates
+{
+	std::vector<VmmapDuplicateRow> regionTypes;
+	std::vector<VmmapDuplicateRow> processes;
+
+	std::size_t scanned = 0;
+	double duplicate = 0;
+
+	// True if the memory was read twice, to keep only the hashes of possible
+	// duplicates. Pages that change between the two reads can be miscounted.
+	bool twoPass = false;
+};
+
+// Hashes the exclusively mapped anonymous pages of all processes and counts
+// how many are byte-identical (up to hash collisions) to another page in the
+// set. Pages that are already shared are skipped, as merging them frees nothing.
+// Returns false if the memory of a process cannot be read.
+bool ScanDuplicatePages(const std::vector<VmmapProcess>& processes, const VmmapArgs& args, VmmapDuplicates& duplicates);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,307 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "family.h"
+#include "map.h"
+#include "pagemap.h"
+#include "parallel.h"
+
+// Every resident page of every process is one 64 bit key:
+// PFN (40 bits, 4P of RAM) | process (12 bits) | region type (12 bits).
+// Sorting the keys brings all mappings of a page together, ordered by process.
+static const int TypeBits = 12;
+static const int ProcessBits = 12;
+static const int PfnShift = TypeBits + ProcessBits;
+static const std::uint64_t MaxPfn = (1ull << (64 - PfnShift)) - 1;
+
+// Buckets per thread for the partitioning pass. More buckets than threads,
+// so that a dense PFN range does not leave one thread doing all the work.
+static const unsigned BucketsPerWorker = 8;
+
+static inline std::uint64_t KeyPfn(std::uint64_t key)
+{
+	return key >> PfnShift;
+}
+
+static inline std::size_t KeyProcess(std::uint64_t key)
+{
+	return (key >> TypeBits) & ((1u << ProcessBits) - 1);
+}
+
+static inline std::size_t KeyType(std::uint64_t key)
+{
+	return key & ((1u << TypeBits) - 1);
+}
+
+static inline int HistogramBucket(std::size_t processes)
+{
+	int bucket = 0;
+	while (bucket < FamilyHistogramBuckets - 1 && (1ull << bucket) < processes)
+	{
+		++bucket;
+	}
+	return bucket;
+}
+
+struct FamilyTotals
+{
+	std::vector<VmmapFamilyRegion> regions;
+	std::vector<VmmapFamilyProcess> processes;
+};
+
+bool ReadFamilySharing(const std::vector<VmmapProcess>& processes, VmmapFamily& family)
+{
+	if (processes.size() >= (1u << ProcessBits))
+	{
+		throw std::invalid_argument("vmmap: too many processes, at most " + std::to_string((1u << ProcessBits) - 1) + " are supported.");
+	}
+
+	std::unordered_map<std::string, std::size_t> typeIndices;
+	std::vector<std::string> types;
+
+	std::vector<std::vector<std::uint64_t>> perWorker(WorkerCount());
+	std::atomic<bool> hiddenPfns(false);
+
+	for (std::size_t process = 0; process < processes.size(); ++process)
+	{
+		std::vector<const VmmapEntry*> regions;
+		std::vector<std::uint64_t> regionTags;
+
+		for (const auto& entry : processes[process].entries)
+		{
+			auto it = typeIndices.find(entry.regionType);
+			if (it == typeIndices.end())
+			{
+				if (types.size() >= (1u << TypeBits))
+				{
+					throw std::invalid_argument("vmmap: too many region types.");
+				}
+				it = typeIndices.insert({ entry.regionType, types.size() }).first;
+				types.push_back(entry.regionType);
+			}
+
+			regions.push_back(&entry);
+			regionTags.push_back(((std::uint64_t)process << TypeBits) | it->second);
+		}
+
+		bool result = WalkPagemap(processes[process].pid, regions, [&](const PagemapBatch& batch)
+		{
+			std::vector<std::uint64_t>& keys = perWorker[batch.worker];
+			std::uint64_t tag = regionTags[batch.region];
+
+			for (std::size_t i = 0; i < batch.count; ++i)
+			{
+				std::uint64_t entry = batch.entries[i];
+				if (!(entry & PagemapPresent))
+				{
+					continue;
+				}
+
+				std::uint64_t pfn = PagemapPfn(entry);
+				if (pfn == 0 || pfn > MaxPfn)
+				{
+					hiddenPfns = true;
+					continue;
+				}
+				keys.push_back((pfn << PfnShift) | tag);
+			}
+		});
+
+		if (!result || hiddenPfns)
+		{
+			return false;
+		}
+	}
+
+	// Partition by PFN range (the most significant digit of a radix sort),
+	// so that every bucket can be sorted and counted on its own.
+	std::uint64_t maxPfn = 0;
+	std::size_t total = 0;
+	for (const auto& keys : perWorker)
+	{
+		for (std::uint64_t key : keys)
+		{
+			maxPfn = std::max(maxPfn, KeyPfn(key));
+		}
+		total += keys.size();
+	}
+
+	std::size_t bucketCount = WorkerCount() * BucketsPerWorker;
+	auto bucketOf = [&](std::uint64_t key)
+	{
+		return (std::size_t)(KeyPfn(key) * bucketCount / (maxPfn + 1));
+	};
+
+	std::vector<std::size_t> bucketStart(bucketCount + 1);
+	for (const auto& keys : perWorker)
+	{
+		for (std::uint64_t key : keys)
+		{
+			++bucketStart[bucketOf(key) + 1];
+		}
+	}
+	for (std::size_t i = 0; i < bucketCount; ++i)
+	{
+		bucketStart[i + 1] += bucketStart[i];
+	}
+
+	std::vector<std::uint64_t> sorted(total);
+	{
+		std::vector<std::size_t> position(bucketStart.begin(), bucketStart.end() - 1);
+		for (auto& keys : perWorker)
+		{
+			for (std::uint64_t key : keys)
+			{
+				sorted[position[bucketOf(key)]++] = key;
+			}
+			std::vector<std::uint64_t>().swap(keys);
+		}
+	}
+
+	std::vector<FamilyTotals> bucketTotals(bucketCount);
+
+	ParallelFor(bucketCount, [&](std::size_t bucket, unsigned)
+	{
+		auto begin = sorted.begin() + bucketStart[bucket];
+		auto end = sorted.begin() + bucketStart[bucket + 1];
+		std::sort(begin, end);
+
+		FamilyTotals& totals = bucketTotals[bucket];
+		totals.regions.resize(types.size());
+		totals.processes.resize(processes.size());
+
+		std::vector<std::size_t> mappedBy;
+		std::vector<std::pair<std::size_t, std::size_t>> typeCounts;
+
+		for (auto run = begin; run != end; )
+		{
+			std::uint64_t pfn = KeyPfn(*run);
+
+			// Distinct processes mapping this page. A process mapping it twice counts once.
+			mappedBy.clear();
+			typeCounts.clear();
+			auto next = run;
+			for (; next != end && KeyPfn(*next) == pfn; ++next)
+			{
+				if (mappedBy.empty() || mappedBy.back() != KeyProcess(*next))
+				{
+					mappedBy.push_back(KeyProcess(*next));
+				}
+
+				auto type = std::find_if(typeCounts.begin(), typeCounts.end(), [&](const std::pair<std::size_t, std::size_t>& typeCount)
+				{
+					return typeCount.first == KeyType(*next);
+				});
+				if (type == typeCounts.end())
+				{
+					typeCounts.push_back({ KeyType(*next), 1 });
+				}
+				else
+				{
+					++type->second;
+				}
+			}
+
+			// The page goes to the type most of its mappings have, and on a tie
+			// to the type whose name sorts first, whatever the process order.
+			std::size_t pageType = typeCounts.front().first;
+			std::size_t pageTypeCount = typeCounts.front().second;
+			for (const auto& typeCount : typeCounts)
+			{
+				if (typeCount.second > pageTypeCount || (typeCount.second == pageTypeCount && types[typeCount.first] < types[pageType]))
+				{
+					pageType = typeCount.first;
+					pageTypeCount = typeCount.second;
+				}
+			}
+
+			std::size_t count = mappedBy.size();
+			VmmapFamilyRegion& region = totals.regions[pageType];
+			region.rss += count;
+			region.unique += 1;
+			region.uss += (count == 1);
+			region.histogram[HistogramBucket(count)] += 1;
+
+			for (std::size_t process : mappedBy)
+			{
+				VmmapFamilyProcess& totalsProcess = totals.processes[process];
+				totalsProcess.rss += 1;
+				totalsProcess.uss += (count == 1);
+				totalsProcess.pss += 1.0 / count;
+			}
+
+			run = next;
+		}
+	});
+
+	family.regions.resize(types.size());
+	for (std::size_t i = 0; i < types.size(); ++i)
+	{
+		family.regions[i].regionType = types[i];
+	}
+
+	family.processes.resize(processes.size());
+	for (std::size_t i = 0; i < processes.size(); ++i)
+	{
+		family.processes[i].pid = processes[i].pid;
+	}
+
+	for (const auto& totals : bucketTotals)
+	{
+		for (std::size_t i = 0; i < totals.regions.size(); ++i)
+		{
+			VmmapFamilyRegion& region = family.regions[i];
+			region.rss += totals.regions[i].rss;
+			region.unique += totals.regions[i].unique;
+			region.uss += totals.regions[i].uss;
+			for (int bucket = 0; bucket < FamilyHistogramBuckets; ++bucket)
+			{
+				region.histogram[bucket] += totals.regions[i].histogram[bucket];
+			}
+		}
+
+		for (std::size_t i = 0; i < totals.processes.size(); ++i)
+		{
+			VmmapFamilyProcess& process = family.processes[i];
+			process.rss += totals.processes[i].rss;
+			process.uss += totals.processes[i].uss;
+			process.pss += totals.processes[i].pss;
+		}
+	}
+
+	for (const auto& region : family.regions)
+	{
+		family.rss += region.rss;
+		family.unique += region.unique;
+	}
+
+	return true;
+}
\ No newline at end of file
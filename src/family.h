@@ -0,0 +1,77 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_FAMILY_H__
+#define VMMAP_FAMILY_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct VmmapProcess;
+
+// Buckets of the "shared with N processes" histogram: 1, 2, 3-4, 5-8, ..., 33-64, 65+.
+const int FamilyHistogramBuckets = 8;
+
+// All counts are in pages of PagemapPageSize() bytes.
+// PSS is kept fractional, so that it adds up across processes.
+// A page mapped as several region types counts towards the type of most of
+// its mappings, and on a tie towards the type whose name sorts first.
+struct VmmapFamilyRegion
+{
+	std::string regionType;
+
+	// Summed over all processes, shared pages are counted once per process.
+	std::size_t rss = 0;
+	// Distinct pages, which is also the sum of PSS over all processes.
+	std::size_t unique = 0;
+	// Pages mapped by only one process of the family.
+	std::size_t uss = 0;
+
+	std::size_t histogram[FamilyHistogramBuckets] = {};
+};
+
+struct VmmapFamilyProcess
+{
+	int pid;
+
+	std::size_t rss = 0;
+	std::size_t uss = 0;
+	double pss = 0;
+};
+
+struct VmmapFamily
+{
+	std::vector<VmmapFamilyRegion> regions;
+	std::vector<VmmapFamilyProcess> processes;
+
+	std::size_t rss = 0;
+	std::size_t unique = 0;
+};
+
+// Collects the PFNs of every resident page of every process, and deduplicates them.
+// Sharing is counted within the family only: a libc page that other processes
+// on the system also map still counts towards USS if only one process here maps it.
+// Returns false if the page frame numbers cannot be read, which needs CAP_SYS_ADMIN.
+bool ReadFamilySharing(const std::vector<VmmapProcess>& processes, VmmapFamily& family);
+
+#endif
\ No newline at end of file
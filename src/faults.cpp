@@ -0,0 +1,194 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "args.h"
+#include "faults.h"
+#include "map.h"
+#include "pagemap.h"
+#include "snapshot.h"
+
+static bool ReadFaultCounters(int pid, std::size_t& minor, std::size_t& major)
+{
+	std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+	std::string stat;
+	std::getline(file, stat);
+
+	// The name may contain anything, including spaces and parentheses.
+	std::size_t close = stat.rfind(')');
+	if (close == std::string::npos)
+	{
+		return false;
+	}
+
+	// Fields after the name start at 3 (state). min_flt is field 10,
+	// maj_flt field 12.
+	std::istringstream fields(stat.substr(close + 1));
+	std::string field;
+	for (int index = 3; fields >> field; ++index)
+	{
+		if (index == 10)
+		{
+			minor = std::stoull(field);
+		}
+		else if (index == 12)
+		{
+			major = std::stoull(field);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool MeasureFaults(const VmmapArgs& args, VmmapSnapshot& snapshot, std::list<VmmapEntry>& entries)
+{
+	const std::size_t pageSize = PagemapPageSize();
+
+	// Guards and reservations cannot fault, and may be far larger than the
+	// rest of the address space, so they are not sampled.
+	std::vector<VmmapEntry*> regions;
+	std::vector<const VmmapEntry*> constRegions;
+	for (auto& entry : entries)
+	{
+		if (entry.prt == "---")
+		{
+			continue;
+		}
+		regions.push_back(&entry);
+		constRegions.push_back(&entry);
+	}
+
+	// The state of every page at the previous sample, one bit per page.
+	std::vector<std::vector<std::uint64_t>> present(regions.size());
+	std::vector<std::vector<std::uint64_t>> swapped(regions.size());
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		std::size_t pages = regions[i]->vsize / pageSize;
+		present[i].resize((pages + 63) / 64);
+		swapped[i].resize((pages + 63) / 64);
+	}
+
+	std::vector<std::atomic<std::size_t>> anon(regions.size());
+	std::vector<std::atomic<std::size_t>> swap(regions.size());
+	std::vector<std::atomic<std::size_t>> file(regions.size());
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		anon[i] = 0;
+		swap[i] = 0;
+		file[i] = 0;
+	}
+
+	bool first = true;
+	// Chunks start at a multiple of 64 pages, so no two workers share a word
+	// of the bitmaps.
+	auto sample = [&]()
+	{
+		return WalkPagemap(args.pid, constRegions, [&](const PagemapBatch& batch)
+		{
+			std::vector<std::uint64_t>& wasPresent = present[batch.region];
+			std::vector<std::uint64_t>& wasSwapped = swapped[batch.region];
+			std::size_t batchAnon = 0;
+			std::size_t batchSwap = 0;
+			std::size_t batchFile = 0;
+
+			for (std::size_t i = 0; i < batch.count; ++i)
+			{
+				std::size_t page = batch.firstPage + i;
+				std::uint64_t bit = 1ull << (page % 64);
+				std::uint64_t entry = batch.entries[i];
+				bool isPresent = (entry & PagemapPresent) != 0;
+
+				if (!first && isPresent && !(wasPresent[page / 64] & bit))
+				{
+					if (wasSwapped[page / 64] & bit)
+					{
+						++batchSwap;
+					}
+					else if (entry & PagemapFile)
+					{
+						++batchFile;
+					}
+					else
+					{
+						++batchAnon;
+					}
+				}
+
+				wasPresent[page / 64] = isPresent ? (wasPresent[page / 64] | bit) : (wasPresent[page / 64] & ~bit);
+				wasSwapped[page / 64] = (entry & PagemapSwapped) ? (wasSwapped[page / 64] | bit) : (wasSwapped[page / 64] & ~bit);
+			}
+
+			anon[batch.region] += batchAnon;
+			swap[batch.region] += batchSwap;
+			file[batch.region] += batchFile;
+		});
+	};
+
+	std::size_t minorBefore = 0;
+	std::size_t majorBefore = 0;
+	if (!ReadFaultCounters(args.pid, minorBefore, majorBefore) || !sample())
+	{
+		return false;
+	}
+	first = false;
+
+	// Regions mapped after the snapshot are not watched.
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(args.faultSeconds);
+	auto interval = std::chrono::milliseconds(args.faultInterval);
+	for (auto now = std::chrono::steady_clock::now(); now < deadline; now = std::chrono::steady_clock::now())
+	{
+		std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(interval, deadline - now));
+		if (!sample())
+		{
+			return false;
+		}
+	}
+
+	std::size_t minorAfter = 0;
+	std::size_t majorAfter = 0;
+	if (!ReadFaultCounters(args.pid, minorAfter, majorAfter))
+	{
+		return false;
+	}
+
+	snapshot.minorFaults = minorAfter - minorBefore;
+	snapshot.majorFaults = majorAfter - majorBefore;
+
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		regions[i]->anonPagesIn = anon[i];
+		regions[i]->swapPagesIn = swap[i];
+		regions[i]->filePagesIn = file[i];
+	}
+
+	return true;
+}
\ No newline at end of file
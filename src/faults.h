@@ -0,0 +1,44 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_FAULTS_H__
+#define VMMAP_FAULTS_H__
+
+#include <list>
+
+struct VmmapArgs;
+struct VmmapEntry;
+struct VmmapSnapshot;
+
+// Samples the pagemap of every region each args.faultInterval ms, for
+// args.faultSeconds, and counts the pages that became present in between
+// into VmmapEntry::anonPagesIn (first touch of anonymous memory),
+// swapPagesIn (swapped before) and filePagesIn (file and shmem pages).
+// VmmapSnapshot::minorFaults and majorFaults get the faults the kernel counted
+// for the whole process meanwhile. The two do not add up: one fault can map
+// many pages (a THP, or fault-around of a file), faults on pages that were
+// already present (copy on write, NUMA hinting) map none, and pages faulted
+// in and dropped again between two samples are not seen.
+// Returns false if the pagemap or the stat file cannot be read.
+bool MeasureFaults(const VmmapArgs& args, VmmapSnapshot& snapshot, std::list<VmmapEntry>& entries);
+
+#endif
\ No newline at end of file
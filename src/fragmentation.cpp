@@ -0,0 +1,171 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "fragmentation.h"
+#include "map.h"
+
+static std::size_t Log2(std::size_t size)
+{
+	std::size_t log = 0;
+	while (size >>= 1)
+	{
+		++log;
+	}
+	return log;
+}
+
+static void AddToHistogram(std::vector<std::size_t>& histogram, std::size_t size)
+{
+	std::size_t bucket = Log2(size);
+	if (histogram.size() <= bucket)
+	{
+		histogram.resize(bucket + 1);
+	}
+	++histogram[bucket];
+}
+
+static void AddHole(VmmapFragmentation& result, std::uintptr_t start, std::uintptr_t end)
+{
+	if (end <= start)
+	{
+		return;
+	}
+
+	VmmapHole hole;
+	hole.start = start;
+	hole.size = end - start;
+
+	++result.holes;
+	result.unmapped += hole.size;
+	AddToHistogram(result.holeSizes, hole.size);
+
+	// A handful of entries, kept sorted.
+	auto it = std::find_if(result.largestHoles.begin(), result.largestHoles.end(), [&](const VmmapHole& other) { return other.size < hole.size; });
+	if (it != result.largestHoles.end() || result.largestHoles.size() < LargestHoleCount)
+	{
+		result.largestHoles.insert(it, hole);
+		if (result.largestHoles.size() > LargestHoleCount)
+		{
+			result.largestHoles.pop_back();
+		}
+	}
+}
+
+// The lowest address mmap() hands out, with a hint or once the address
+// space below the mmap base is used up.
+static std::uintptr_t ReadMmapMinAddr()
+{
+	std::ifstream file("/proc/sys/vm/mmap_min_addr");
+	std::uintptr_t address = 0;
+	if (!(file >> address))
+	{
+		// The usual default of distributions.
+		address = 64 * 1024;
+	}
+	return address;
+}
+
+static bool IsGrowing(const VmmapEntry& entry)
+{
+	return entry.regionType == "Stack" || entry.regionType == "MALLOC" || entry.regionDetail == "[heap]";
+}
+
+static bool IsInaccessible(const VmmapEntry& entry)
+{
+	return entry.prt == "---" && !entry.sharedMapping;
+}
+
+VmmapFragmentation AnalyzeFragmentation(const std::list<VmmapEntry>& entries)
+{
+	VmmapFragmentation result;
+
+	// 4-level page tables give 47 bits to user space, 5-level ones 56, but
+	// the kernel only maps above 47 bits on request.
+	const std::uintptr_t userLimit = (std::uintptr_t)1 << 56;
+	std::uintptr_t addressLimit = (std::uintptr_t)1 << result.addressBits;
+
+	const VmmapEntry* previous = nullptr;
+	bool previousIsGuard = false;
+	std::uintptr_t holeStart = ReadMmapMinAddr();
+
+	for (const auto& entry : entries)
+	{
+		// [vsyscall] is in the kernel half.
+		if ((std::uintptr_t)entry.startAddress >= userLimit)
+		{
+			break;
+		}
+		if ((std::uintptr_t)entry.endAddress > addressLimit)
+		{
+			result.addressBits = 56;
+			addressLimit = userLimit;
+		}
+
+		++result.regions;
+		result.mapped += entry.vsize;
+		AddToHistogram(result.regionSizes, entry.vsize);
+
+		bool adjacent = previous && previous->endAddress == entry.startAddress;
+		bool isGuard = false;
+
+		AddHole(result, previous ? (std::uintptr_t)previous->endAddress : holeStart, entry.startAddress);
+
+		if (IsInaccessible(entry))
+		{
+			// Above a heap, which grows up.
+			isGuard = adjacent && IsGrowing(*previous);
+			if (isGuard)
+			{
+				++result.guards;
+				result.guardBytes += entry.vsize;
+			}
+			else
+			{
+				++result.reservations;
+				result.reservedBytes += entry.vsize;
+			}
+		}
+
+		// Below a stack, which grows down. The previous region was counted
+		// as a reservation, but it is a guard after all.
+		if (adjacent && IsGrowing(entry) && IsInaccessible(*previous) && !previousIsGuard)
+		{
+			--result.reservations;
+			result.reservedBytes -= previous->vsize;
+			++result.guards;
+			result.guardBytes += previous->vsize;
+		}
+
+		previous = &entry;
+		previousIsGuard = isGuard;
+	}
+
+	AddHole(result, previous ? (std::uintptr_t)previous->endAddress : holeStart, addressLimit);
+
+	return result;
+}
\ No newline at end of file
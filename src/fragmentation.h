@@ -0,0 +1,72 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_FRAGMENTATION_H__
+#define VMMAP_FRAGMENTATION_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <vector>
+
+struct VmmapEntry;
+
+// An unmapped range of the address space.
+struct VmmapHole
+{
+	std::uintptr_t start = 0;
+	std::size_t size = 0;
+};
+
+struct VmmapFragmentation
+{
+	// The user address space, 47 or 56 bits.
+	int addressBits = 47;
+
+	std::size_t regions = 0;
+	std::size_t mapped = 0;
+
+	// Between mmap_min_addr and the address limit.
+	std::size_t holes = 0;
+	std::size_t unmapped = 0;
+	// Largest first.
+	std::vector<VmmapHole> largestHoles;
+
+	// ---p regions right below or above a stack or a heap.
+	std::size_t guards = 0;
+	std::size_t guardBytes = 0;
+	// Other ---p regions: address space reserved, but not usable yet.
+	std::size_t reservations = 0;
+	std::size_t reservedBytes = 0;
+
+	// Indexed by floor(log2(size)).
+	std::vector<std::size_t> regionSizes;
+	std::vector<std::size_t> holeSizes;
+};
+
+// How many of the largest holes are kept.
+const std::size_t LargestHoleCount = 8;
+
+// One pass over the regions, which must be sorted by address.
+VmmapFragmentation AnalyzeFragmentation(const std::list<VmmapEntry>& entries);
+
+#endif
\ No newline at end of file
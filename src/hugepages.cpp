@@ -0,0 +1,111 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "hugepages.h"
+#include "map.h"
+#include "snapshot.h"
+
+static std::string ReadLine(const std::string& path)
+{
+	std::ifstream file(path);
+	std::string line;
+	std::getline(file, line);
+	return line;
+}
+
+std::size_t ReadPmdSize()
+{
+	std::string pmdSize = ReadLine(SystemPrefix + "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+	return pmdSize.empty() ? 2 * 1024 * 1024 : std::stoull(pmdSize);
+}
+
+VmmapThpSettings ReadThpSettings(const VmmapSnapshot& snapshot)
+{
+	VmmapThpSettings settings;
+	std::string directory = SystemPrefix + "/sys/kernel/mm/transparent_hugepage";
+
+	// In the form of "always [madvise] never".
+	std::string enabled = ReadLine(directory + "/enabled");
+	std::size_t open = enabled.find('[');
+	std::size_t close = enabled.find(']', open);
+	if (open != std::string::npos && close != std::string::npos)
+	{
+		settings.enabled = enabled.substr(open + 1, close - open - 1);
+	}
+
+	settings.pmdSize = ReadPmdSize();
+
+	// Only there since Linux 5.0; older kernels cannot tell.
+	std::istringstream status(snapshot.status.Contents());
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.compare(0, 12, "THP_enabled:") == 0)
+		{
+			settings.processEnabled = std::stoi(line.substr(12)) != 0;
+			break;
+		}
+	}
+
+	return settings;
+}
+
+bool IsThpEligible(const VmmapEntry& entry, const VmmapThpSettings& settings)
+{
+	// File and shared memory is only backed by huge pages with tmpfs
+	// huge= mounts or READ_ONLY_THP_FOR_FS, leave those out.
+	if (!settings.processEnabled || entry.hugetlb || entry.inode != 0 || entry.sharedMapping || entry.thpAdvice == "nh")
+	{
+		return false;
+	}
+
+	// Guard regions and ---p reservations never fault, and read-only
+	// anonymous memory only ever maps the zero page.
+	if (entry.prt[READ_INDEX] != 'r' || entry.prt[WRITE_INDEX] != 'w')
+	{
+		return false;
+	}
+
+	return settings.enabled == "always" || (settings.enabled == "madvise" && entry.thpAdvice == "hg");
+}
+
+void EstimateThpEligibility(const VmmapSnapshot& snapshot, std::list<VmmapEntry>& entries)
+{
+	VmmapThpSettings settings = ReadThpSettings(snapshot);
+	const std::uintptr_t pmdSize = settings.pmdSize;
+
+	for (auto& entry : entries)
+	{
+		if (!IsThpEligible(entry, settings))
+		{
+			continue;
+		}
+
+		std::uintptr_t start = ((std::uintptr_t)entry.startAddress + pmdSize - 1) & ~(pmdSize - 1);
+		std::uintptr_t end = (std::uintptr_t)entry.endAddress & ~(pmdSize - 1);
+		entry.thpEligibleBytes = (end > start) ? end - start : 0;
+	}
+}
\ No newline at end of file
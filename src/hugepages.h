@@ -0,0 +1,60 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_HUGEPAGES_H__
+#define VMMAP_HUGEPAGES_H__
+
+#include <cstddef>
+#include <list>
+#include <string>
+
+struct VmmapEntry;
+struct VmmapSnapshot;
+
+// Transparent huge page settings, system wide and for one process.
+struct VmmapThpSettings
+{
+	// The selected mode of /sys/kernel/mm/transparent_hugepage/enabled:
+	// "always", "madvise" or "never". Empty if THP is not built in.
+	std::string enabled;
+	std::size_t pmdSize = 2 * 1024 * 1024;
+	// False if the process disabled THP with PR_SET_THP_DISABLE.
+	bool processEnabled = true;
+};
+
+// The system wide settings, and THP_enabled from the status file in the
+// snapshot.
+VmmapThpSettings ReadThpSettings(const VmmapSnapshot& snapshot);
+
+// The size of a PMD-mapped huge page, from hpage_pmd_size: 2M with 4K pages,
+// 512M on arm64 with 64K pages. 2M if the kernel has no THP.
+std::size_t ReadPmdSize();
+
+// Whether the kernel would back anonymous memory of the region with THP,
+// from the mode and the MADV_HUGEPAGE/MADV_NOHUGEPAGE advice of the region.
+bool IsThpEligible(const VmmapEntry& entry, const VmmapThpSettings& settings);
+
+// Fills VmmapEntry::thpEligibleBytes: the PMD-aligned spans of every eligible
+// region, which are the only parts a huge page can back.
+void EstimateThpEligibility(const VmmapSnapshot& snapshot, std::list<VmmapEntry>& entries);
+
+#endif
\ No newline at end of file
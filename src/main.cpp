@@ -26,8 +26,12 @@
 
 #include "args.h"
 #include "debug.h"
+#include "duplicates.h"
+#include "family.h"
 #include "map.h"
 #include "print.h"
+#include "snapshot.h"
+#include "text.h"
 
 #include <unistd.h>
 
@@ -52,12 +56,59 @@ int main(int argc, char** argv)
 		return 255;
 	}
 
-	std::list<VmmapEntry> entries;
+	std::vector<VmmapProcess> processes;
+	std::vector<VmmapSnapshot> snapshots(args.pids.size());
 
 	try
 	{
-		entries = Map(args);
-		Print(entries, args);
+		for (std::size_t i = 0; i < args.pids.size(); ++i)
+		{
+			VmmapArgs processArgs = args;
+			processArgs.pid = args.pids[i];
+			processes.push_back({ args.pids[i], Map(processArgs, snapshots[i]) });
+		}
+
+		// Every process gets its own report, as if vmmap ran once for each.
+		for (std::size_t i = 0; i < processes.size(); ++i)
+		{
+			VmmapArgs processArgs = args;
+			processArgs.pid = processes[i].pid;
+			Print(processes[i].entries, processArgs, snapshots[i]);
+		}
+
+		if (processes.size() > 1)
+		{
+			// Then what they share, which needs all of them.
+			VmmapFamily family;
+			if (!ReadFamilySharing(processes, family))
+			{
+				throw std::invalid_argument("vmmap: reading page frame numbers of several processes needs root; try running with `sudo`.");
+			}
+
+			PrintFamily(family, args);
+		}
+
+		if (args.duplicates)
+		{
+			VmmapDuplicates duplicates;
+			if (!ScanDuplicatePages(processes, args, duplicates))
+			{
+				throw std::invalid_argument("vmmap: -duplicates cannot read the memory of the process; try running with `sudo`.");
+			}
+
+			PrintDuplicates(duplicates, args);
+		}
+
+		if (args.text)
+		{
+			VmmapText text;
+			if (!AnalyzeText(processes, text))
+			{
+				throw std::invalid_argument("vmmap: -text cannot read the pagemap of the process; try running with `sudo`.");
+			}
+
+			PrintText(text, args);
+		}
 	}
 	catch (std::invalid_argument& e)
 	{
@@ -21,7 +21,6 @@
 // SOFTWARE.
 
 #include <cstdint>
-#include <fstream>
 #include <list>
 #include <regex>
 #include <sstream>
@@ -33,8 +32,24 @@
 #include <unistd.h>
 
 #include "args.h"
+#include "arenas.h"
+#include "compress.h"
+#include "damon.h"
 #include "debug.h"
+#include "faults.h"
+#include "hugepages.h"
 #include "map.h"
+#include "numa.h"
+#include "pagecache.h"
+#include "pagetables.h"
+#include "pagemap.h"
+#include "sharing.h"
+#include "softdirty.h"
+#include "stacks.h"
+#include "swap.h"
+#include "workingset.h"
+#include "zeropages.h"
+#include "snapshot.h"
 
 // This current implementation is intended to be used for 
 // Darling only, because of two reasons:
@@ -64,7 +79,7 @@ static void BadPid(int pid);
 static void BadPerm(int pid);
 
 const std::string SystemPrefix = "/Volumes/SystemRoot";
-std::list<VmmapEntry> Map(const VmmapArgs& args)
+std::list<VmmapEntry> Map(const VmmapArgs& args, VmmapSnapshot& snapshot)
 {
 	// Differentiate between non-existent pid and insufficient permissions.
 	getpgid(args.pid);
@@ -79,27 +94,17 @@ std::list<VmmapEntry> Map(const VmmapArgs& args)
 		BadPerm(args.pid);
 	}
 
-	std::list<VmmapEntry> entries;
-
-	std::string fileName = "/proc/";
-	fileName += std::to_string(args.pid);
+	CaptureSnapshot(args.pid, args, snapshot);
 
-	std::string smapsName = fileName + "/smaps";
-	std::string mapsName = fileName + "/maps";
-
-	std::ifstream proc_maps(smapsName);
-	if (!proc_maps.is_open())
+	const VmmapSnapshotFile& source = snapshot.smaps.present ? snapshot.smaps : snapshot.maps;
+	if (!source.present)
 	{
-		// smaps is not always present.
-		// Fallback to maps, although we'll lose quite a lot of information.
-		DEBUG_PRINT("Failed to open smaps.");
-		proc_maps.open(mapsName);
-		if (!proc_maps.is_open())
-		{
-			BadPid(args.pid);
-		}
+		BadPid(args.pid);
 	}
 
+	std::list<VmmapEntry> entries;
+	std::istringstream proc_maps(source.Contents());
+
 	LinuxEntry currentLinuxEntry;
 
 	const std::regex regex("([0-9a-fA-F]*)-([0-9a-fA-F]*)\\s*([rwxsp-]*)\\s*([0-9a-fA-F]*)\\s*([0-9a-fA-F]*):([0-9a-fA-F]*)\\s*([0-9a-fA-F]*)\\s*([\\S\\s]*)");
@@ -179,6 +184,112 @@ std::list<VmmapEntry> Map(const VmmapArgs& args)
 			}
 		}
 	}
+
+	// The same shared object, mapped more than once by this process.
+	std::unordered_map<std::string, int> sharedObjects;
+	for (const auto & entry : entries)
+	{
+		if (entry.sharedMapping && entry.inode != 0)
+		{
+			++sharedObjects[entry.device + ":" + std::to_string(entry.inode)];
+		}
+	}
+
+	for (auto & entry : entries)
+	{
+		if (!entry.sharedMapping || entry.inode == 0 || sharedObjects[entry.device + ":" + std::to_string(entry.inode)] < 2)
+		{
+			continue;
+		}
+
+		if (entry.shrmod == "SHM")
+		{
+			entry.shrmod = "S/A";
+		}
+		else if (entry.shrmod == "PRV")
+		{
+			entry.shrmod = "ALI";
+		}
+	}
+
+	IdentifyThreadStacks(snapshot, entries);
+
+	if (args.threadStacks && !MeasureStackDepth(args.pid, entries))
+	{
+		throw std::invalid_argument("vmmap: -threadstacks cannot read /proc/" + std::to_string(args.pid) + "/pagemap; try running with `sudo`.");
+	}
+
+	// After the stacks, which are anonymous memory as well.
+	if (args.arenas && !WalkArenas(args, entries))
+	{
+		throw std::invalid_argument("vmmap: -arenas cannot read the memory of process " + std::to_string(args.pid) + "; try running with `sudo`.");
+	}
+
+	if (args.numa && !ReadNumaPlacement(snapshot, entries))
+	{
+		throw std::invalid_argument("vmmap: -numa needs /proc/" + std::to_string(args.pid) + "/numa_maps, which the kernel only has with CONFIG_NUMA.");
+	}
+
+	if (args.pageTables && !EstimatePageTables(args.pid, entries))
+	{
+		throw std::invalid_argument("vmmap: -pagetables cannot read /proc/" + std::to_string(args.pid) + "/pagemap; try running with `sudo`.");
+	}
+
+	if (args.swapDevices && !ReadSwapPlacement(args.pid, entries))
+	{
+		throw std::invalid_argument("vmmap: -swap cannot read /proc/" + std::to_string(args.pid) + "/pagemap; try running with `sudo`.");
+	}
+
+	if (args.pageCache)
+	{
+		// After the regions got their SystemPrefix, which we need to open them.
+		ReadPageCache(entries);
+	}
+
+	if (args.hugePages)
+	{
+		EstimateThpEligibility(snapshot, entries);
+	}
+
+	if (args.preciseSharing && !ReadPreciseSharing(args.pid, entries))
+	{
+		throw std::invalid_argument("vmmap: -preciseSharing needs to read page frame numbers from /proc/" + std::to_string(args.pid) + "/pagemap and /proc/kpagecount; try running with `sudo`.");
+	}
+
+	if (args.zeroPages && !ScanZeroPages(args, entries))
+	{
+		throw std::invalid_argument("vmmap: -zeropages cannot read the memory of process " + std::to_string(args.pid) + "; try running with `sudo`.");
+	}
+
+	if (args.compressibility && !EstimateCompressibility(args, entries))
+	{
+		throw std::invalid_argument("vmmap: -compressibility cannot read the memory of process " + std::to_string(args.pid) + "; try running with `sudo`.");
+	}
+
+	if (args.workingSetSeconds != 0 && !MeasureWorkingSet(args, entries))
+	{
+		throw std::invalid_argument("vmmap: -workingset needs idle page tracking (CONFIG_IDLE_PAGE_TRACKING) and page frame numbers from /proc/" + std::to_string(args.pid) + "/pagemap; try running with `sudo`.");
+	}
+
+	if (args.damonSeconds != 0 && !MeasureDamonHeat(args, entries))
+	{
+		throw std::invalid_argument("vmmap: -damon needs the DAMON sysfs interface (CONFIG_DAMON_SYSFS and CONFIG_DAMON_VADDR), not already in use by another kdamond; try running with `sudo`.");
+	}
+
+	if (args.writeSeconds != 0 && !MeasureWrites(args, entries))
+	{
+		throw std::invalid_argument("vmmap: -writes needs to write /proc/" + std::to_string(args.pid) + "/clear_refs and read its pagemap (CONFIG_MEM_SOFT_DIRTY); try running with `sudo`.");
+	}
+
+	if (args.faultSeconds != 0 && !MeasureFaults(args, snapshot, entries))
+	{
+		throw std::invalid_argument("vmmap: -faults cannot read /proc/" + std::to_string(args.pid) + "/pagemap, or the process exited; try running with `sudo`.");
+	}
+
+	if (args.pages && !ReadPageStates(args.pid, snapshot.smaps.present, entries))
+	{
+		DEBUG_PRINT("Failed to read page states, page counts are estimated from smaps.");
+	}
 	
 	return entries;
 }
@@ -218,6 +329,12 @@ static size_t ParseSize(std::string size)
 	}
 }
 
+static size_t TagSize(const LinuxEntry& entry, const std::string& name)
+{
+	auto it = entry.tags.find(name);
+	return (it != entry.tags.end()) ? ParseSize(it->second) : 0;
+}
+
 static std::unordered_set<std::string> MakeTagSet(const std::string& str)
 {
 	std::stringstream ss(str);
@@ -284,6 +401,42 @@ static VmmapEntry LinuxToVmmap(const LinuxEntry& entry)
 	{
 		vmmapEntry.swap = ParseSize(entry.tags.at("Swap"));
 	}
+	// Pss_Dirty is only there since Linux 6.0.
+	vmmapEntry.pss = TagSize(entry, "Pss");
+	vmmapEntry.pssDirty = TagSize(entry, "Pss_Dirty");
+
+	// smaps_rollup splits the PSS by page type, smaps does not. Shmem lives
+	// in shared anonymous mappings (/dev/zero) and in tmpfs files (SysV, memfd,
+	// /dev/shm). Anywhere else, "Anonymous" are the resident anonymous pages
+	// (COW copies), and the rest is file cache. "Anonymous" is an RSS figure,
+	// and anonymous pages are still shared with the parent after fork, so it
+	// is scaled by Pss/Rss. That assumes anonymous and file pages of the
+	// region are shared alike, so the split is an estimate.
+	bool shmem = (!entry.permissions.empty() && entry.permissions.back() == 's' && (entry.inode == "0" || entry.inode.empty()))
+		|| entry.description.compare(0, 5, "/SYSV") == 0
+		|| entry.description.compare(0, 7, "/memfd:") == 0
+		|| entry.description.compare(0, 9, "/dev/zero") == 0
+		|| entry.description.compare(0, 9, "/dev/shm/") == 0;
+	if (shmem)
+	{
+		vmmapEntry.pssShmem = vmmapEntry.pss;
+	}
+	else
+	{
+		std::uint64_t rss = TagSize(entry, "Rss");
+		std::uint64_t anonymous = TagSize(entry, "Anonymous");
+		if (rss != 0)
+		{
+			vmmapEntry.pssAnon = std::min<std::uint64_t>((std::uint64_t)((double)anonymous * vmmapEntry.pss / rss), vmmapEntry.pss);
+		}
+		vmmapEntry.pssFile = vmmapEntry.pss - vmmapEntry.pssAnon;
+	}
+
+	vmmapEntry.swapPss = entry.tags.count("SwapPss") ? TagSize(entry, "SwapPss") : vmmapEntry.swap;
+
+	// MADV_FREE clears the dirty bits, so LazyFree pages are left out, as
+	// volatile purgeable memory is on macOS.
+	vmmapEntry.footprint = TagSize(entry, "Private_Dirty") + vmmapEntry.swapPss;
 
 	// Now to the protection.
 	// There are two sources: Normal permissions, and the "VmFlags" tag.
@@ -321,15 +474,80 @@ static VmmapEntry LinuxToVmmap(const LinuxEntry& entry)
 		}
 	}
 
+	// Huge pages.
+	vmmapEntry.thpBytes = TagSize(entry, "AnonHugePages") + TagSize(entry, "ShmemPmdMapped") + TagSize(entry, "FilePmdMapped");
+	vmmapEntry.hugetlbBytes = TagSize(entry, "Shared_Hugetlb") + TagSize(entry, "Private_Hugetlb");
+	vmmapEntry.hugetlb = flags.count("ht") != 0;
+	if (flags.count("hg"))
+	{
+		vmmapEntry.thpAdvice = "hg";
+	}
+	else if (flags.count("nh"))
+	{
+		vmmapEntry.thpAdvice = "nh";
+	}
+
+	// Commit charge and locking.
+	vmmapEntry.accountable = flags.count("ac") != 0;
+	vmmapEntry.noReserve = flags.count("nr") != 0;
+	vmmapEntry.lockedRegion = flags.count("lo") != 0;
+	vmmapEntry.locked = TagSize(entry, "Locked");
+
+	// KSM. The counter is only there since Linux 6.7.
+	vmmapEntry.ksmBytes = TagSize(entry, "KSM");
+	vmmapEntry.ksmMergeable = flags.count("mg") != 0;
+
 	// Sharing mode
-	vmmapEntry.shrmod = "NUL";
+	// Linux has no notion of memory objects, so this is an approximation of
+	// what vm_region would say, from the page counters:
+	// - Nothing resident or swapped: ZER for private anonymous memory, which
+	//   will be zero filled on first touch, NUL for anything else.
+	// - Private mappings: COW if some pages are still shared with other
+	//   mappings (the page cache, or the parent after fork()), PRV otherwise.
+	// - Shared mappings: SHM if the pages are mapped elsewhere, PRV otherwise.
+	// Aliases (the same object mapped twice) are detected later, in Map().
+	bool shared = (entry.permissions.size() > 3 && entry.permissions[3] == 's') || flags.count("sh");
+	bool anonymous = entry.inode == "0" || entry.inode.empty();
+	vmmapEntry.sharedMapping = shared;
+	std::size_t sharedPages = TagSize(entry, "Shared_Clean") + TagSize(entry, "Shared_Dirty");
+
+	if (!entry.tags.count("Rss"))
+	{
+		// Plain maps, no way to tell.
+		vmmapEntry.shrmod = shared ? "SHM" : "PRV";
+	}
+	else if (vmmapEntry.rss == 0 && vmmapEntry.swap == 0)
+	{
+		vmmapEntry.shrmod = (anonymous && !shared) ? "ZER" : "NUL";
+	}
+	else if (shared)
+	{
+		vmmapEntry.shrmod = sharedPages ? "SHM" : "PRV";
+	}
+	else
+	{
+		vmmapEntry.shrmod = sharedPages ? "COW" : "PRV";
+	}
 
 	// Purge
-	// I don't know what this is? It is usually empty on my Mac.
+	// Darwin purgeable memory is memory the kernel may drop under pressure
+	// without writing it anywhere. On Linux, that is memory the process gave
+	// back with MADV_FREE and has not written to since (LazyFree):
+	// - V (volatile): some resident pages are lazily freeable.
+	// - E (empty): all of them are, the region only holds garbage.
+	// There is no such thing as a nonvolatile (N) region here.
+	vmmapEntry.lazyFree = TagSize(entry, "LazyFree");
 	vmmapEntry.purge = "";
+	if (vmmapEntry.lazyFree != 0)
+	{
+		vmmapEntry.purge = (vmmapEntry.lazyFree >= vmmapEntry.rss) ? "E" : "V";
+	}
 
 	// Region description.
 	vmmapEntry.regionDetail = entry.description;
+	vmmapEntry.device = entry.dev;
+	vmmapEntry.inode = std::stoull(entry.inode.empty() ? "0" : entry.inode);
+	vmmapEntry.offset = entry.offset;
 
 	// Region type.
 	// Most of the time, it's VM_ALLOCATE.
@@ -26,7 +26,11 @@
 #include <cstring>
 #include <cstdint>
 #include <list>
+#include <memory>
 #include <string>
+#include <vector>
+
+struct VmmapPageStates;
 
 struct VmmapEntry
 {
@@ -39,16 +43,156 @@ struct VmmapEntry
 	std::size_t dirty;
 	std::size_t swap;
 
+	// What this region adds to the physical footprint, as macOS defines it:
+	// dirty pages no one else maps, anonymous or file backed, plus swapped
+	// pages.
+	std::size_t footprint = 0;
+
+	// Proportional set size: pages shared with n processes count 1/n.
+	// In bytes, summed as 64 bit integers. smaps rounds every region down to
+	// whole kilobytes, smaps_rollup only the process total. The anon/file
+	// split of a region is estimated, see LinuxToVmmap().
+	std::uint64_t pss = 0;
+	std::uint64_t pssDirty = 0;
+	std::uint64_t pssAnon = 0;
+	std::uint64_t pssFile = 0;
+	std::uint64_t pssShmem = 0;
+	// The share of swap of this process: swapped pages shared with n
+	// processes count 1/n. Equals swap on kernels without SwapPss.
+	std::size_t swapPss = 0;
+	// Only read with -swap. Swapped bytes per swap area, see ReadSwapDevices().
+	std::vector<std::size_t> swapDeviceBytes;
+
 	std::size_t pageSize;
 
 	std::string prt;
 	std::string max;
 
 	std::string shrmod;
+	bool sharedMapping = false;
 
 	std::string purge;
+	// Bytes freed with MADV_FREE that the kernel can drop for free, see purge.
+	std::size_t lazyFree = 0;
 	std::string regionDetail;
 
+	// The backing file, if any. inode is 0 for anonymous memory.
+	std::string device;
+	std::uint64_t inode = 0;
+	std::uint64_t offset = 0;
+
+	// Only read with -pagecache.
+	// Bytes of the mapped range of the file in the page cache, mapped here or not.
+	std::size_t cachedBytes = 0;
+	// False when the file could not be queried, see ReadPageCache().
+	bool cacheKnown = false;
+
+	// Huge pages, from smaps.
+	// THP mapped by PMD (anonymous, shmem or file), and hugetlb pages, whose
+	// size is pageSize. thpAdvice is "hg" after MADV_HUGEPAGE, "nh" after
+	// MADV_NOHUGEPAGE, and empty otherwise.
+	std::size_t thpBytes = 0;
+	std::size_t hugetlbBytes = 0;
+	bool hugetlb = false;
+	std::string thpAdvice;
+
+	// Bytes of the region backed by KSM pages, and whether it was
+	// registered with KSM (MADV_MERGEABLE or PR_SET_MEMORY_MERGE).
+	std::size_t ksmBytes = 0;
+	bool ksmMergeable = false;
+
+	// Commit charge and locking.
+	// Private writable mappings are charged against the commit limit for their
+	// whole size (VmFlags ac), unless mapped with MAP_NORESERVE (nr). Locked
+	// regions (lo) count towards RLIMIT_MEMLOCK for their whole size, locked
+	// is what is resident of them.
+	bool accountable = false;
+	bool noReserve = false;
+	bool lockedRegion = false;
+	std::size_t locked = 0;
+
+	inline std::size_t CommitCharge() const
+	{
+		return accountable ? vsize : 0;
+	}
+
+	// Only read with -faults.
+	// Pages that became present while sampling the pagemap: first touches of
+	// anonymous memory, swap-ins, and file pages, from the page cache or not.
+	// These are pages, not faults: one fault can map a whole THP, or the
+	// fault_around_bytes around a file page.
+	std::size_t anonPagesIn = 0;
+	std::size_t swapPagesIn = 0;
+	std::size_t filePagesIn = 0;
+
+	// Only read with -arenas.
+	// Chunks in use of the glibc malloc heap in this region, and their usable
+	// size. Chunks cached in tcache count as in use.
+	bool mallocWalked = false;
+	std::size_t mallocCount = 0;
+	std::size_t mallocBytes = 0;
+	// The heap_info and malloc_state at the start of a thread arena heap,
+	// which are neither allocated nor free.
+	std::size_t mallocHeaderBytes = 0;
+
+	// The thread whose stack pointer is in this region, 0 if none.
+	int stackThread = 0;
+	// Only read with -threadstacks.
+	// From the lowest populated page to the end of the region: stacks grow
+	// down, so this is as deep as the stack ever got.
+	std::size_t stackTouchedBytes = 0;
+
+	// Only read with -pagetables.
+	// Page tables charged to this region, see EstimatePageTables().
+	std::size_t pageTableBytes = 0;
+
+	// Only read with -hugepages.
+	std::size_t thpEligibleBytes = 0;
+
+	// Only read with -numa.
+	// Resident bytes on every NUMA node, the memory policy of the region, and
+	// whether most of it is on nodes none of the threads run on.
+	std::vector<std::size_t> nodeBytes;
+	std::string numaPolicy;
+	bool numaRemote = false;
+
+	// Only read with -preciseSharing.
+	// Resident pages mapped exactly once, or more than once, system wide.
+	std::size_t privatePages = 0;
+	std::size_t sharedPages = 0;
+
+	// Only read with -zeropages.
+	std::size_t scannedPages = 0;
+	std::size_t zeroPages = 0;
+
+	// Only read with -compressibility.
+	// Exclusive anonymous pages, how many of them were compressed, and what all
+	// of them would compress to, with the variance of that estimate.
+	std::size_t compressiblePages = 0;
+	std::size_t compressionSamples = 0;
+	double compressedBytes = 0;
+	double compressedVariance = 0;
+
+	// Only read with -workingset.
+	// Resident pages touched, or not, during the measurement interval.
+	std::size_t accessedPages = 0;
+	std::size_t idlePages = 0;
+
+	// Only read with -damon.
+	// Bytes of the region that DAMON found accessed in at least half, some, or
+	// none of its samples over the whole -damon window, counted in cells of 2M
+	// or more.
+	std::size_t hotBytes = 0;
+	std::size_t warmBytes = 0;
+	std::size_t coldBytes = 0;
+
+	// Only read with -writes.
+	// Pages written during the measurement interval, writable regions only.
+	std::size_t writtenPages = 0;
+
+	// Only read with -pages.
+	std::shared_ptr<const VmmapPageStates> pageStates;
+
 	inline bool IsMalloc() const
 	{
 		return strncmp(regionType.c_str(), "MALLOC", 6) == 0;
@@ -64,18 +208,97 @@ struct VmmapSummaryEntry
 	std::size_t dirty = 0;
 	std::size_t swap = 0;
 
+	std::size_t footprint = 0;
+
+	// See VmmapEntry::mallocCount.
+	bool mallocWalked = false;
+	std::size_t mallocCount = 0;
+	std::size_t mallocBytes = 0;
+	std::size_t mallocHeaderBytes = 0;
+
+	// See VmmapEntry::anonPagesIn.
+	std::size_t anonPagesIn = 0;
+	std::size_t swapPagesIn = 0;
+	std::size_t filePagesIn = 0;
+
+	// See VmmapEntry::pss.
+	std::uint64_t pss = 0;
+	std::uint64_t pssDirty = 0;
+	std::uint64_t pssAnon = 0;
+	std::uint64_t pssFile = 0;
+	std::uint64_t pssShmem = 0;
+
 	std::size_t vol = 0;
 	std::size_t nonvol = 0;
 	std::size_t empty = 0;
 
 	std::size_t regionCount = 0;
 
+	// See VmmapEntry::thpBytes.
+	std::size_t thp = 0;
+	std::size_t thpEligible = 0;
+	std::size_t hugetlb = 0;
+
+	// See VmmapEntry::CommitCharge().
+	std::size_t commitCharge = 0;
+	std::size_t locked = 0;
+
+	// See VmmapEntry::pageTableBytes.
+	std::size_t pageTables = 0;
+
+	// See VmmapEntry::ksmBytes.
+	std::size_t ksm = 0;
+
+	// See VmmapEntry::cachedBytes. Whether the files of some regions of the
+	// type could be queried, and whether the files of others could not.
+	std::size_t cached = 0;
+	bool cachedKnown = false;
+	bool cachedUnknown = false;
+
+	// See VmmapEntry::swapDeviceBytes.
+	std::vector<std::size_t> swapDeviceBytes;
+
+	// See VmmapEntry::nodeBytes.
+	std::vector<std::size_t> nodeBytes;
+
+	// Estimated from samples, see VmmapEntry::compressedBytes.
+	std::size_t compressible = 0;
+	double compressed = 0;
+	double compressedVariance = 0;
+
+	// In bytes, see VmmapEntry::accessedPages.
+	std::size_t accessed = 0;
+	std::size_t idle = 0;
+
+	// See VmmapEntry::hotBytes.
+	std::size_t hot = 0;
+	std::size_t warm = 0;
+	std::size_t cold = 0;
+
+	// In bytes, see VmmapEntry::writtenPages.
+	std::size_t written = 0;
+
+	// Exact page counts, from VmmapEntry::pageStates.
+	std::size_t pages = 0;
+	std::size_t presentPages = 0;
+	std::size_t swappedPages = 0;
+	std::size_t exclusivePages = 0;
+	std::size_t softDirtyPages = 0;
+	std::size_t filePages = 0;
+
 	inline bool IsMalloc() const
 	{
 		return strncmp(regionType.c_str(), "MALLOC", 6) == 0;
 	}
 };
 
+// The regions of one of the processes given on the command line.
+struct VmmapProcess
+{
+	int pid;
+	std::list<VmmapEntry> entries;
+};
+
 enum
 {
 	READ_INDEX,
@@ -83,6 +306,12 @@ enum
 	EXECUTE_INDEX
 };
 
-std::list<VmmapEntry> Map(const VmmapArgs& args);
+struct VmmapArgs;
+struct VmmapSnapshot;
+
+// Where the Linux root is visible from inside the Darling prefix.
+extern const std::string SystemPrefix;
+
+std::list<VmmapEntry> Map(const VmmapArgs& args, VmmapSnapshot& snapshot);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,169 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "pagemap.h"
+
+MemoryReader::MemoryReader(int pid, std::size_t bytesPerSecond)
+	: bytesPerSecond(bytesPerSecond), nextRead(std::chrono::steady_clock::now())
+{
+	std::string path = "/proc/" + std::to_string(pid) + "/mem";
+	fd = open(path.c_str(), O_RDONLY);
+	path = "/proc/" + std::to_string(pid) + "/pagemap";
+	pagemapFd = open(path.c_str(), O_RDONLY);
+}
+
+MemoryReader::~MemoryReader()
+{
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+	if (pagemapFd >= 0)
+	{
+		close(pagemapFd);
+	}
+}
+
+void MemoryReader::Throttle(std::size_t size)
+{
+	if (bytesPerSecond <= 0)
+	{
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		start = std::max(nextRead, std::chrono::steady_clock::now());
+		nextRead = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(size / bytesPerSecond));
+	}
+
+	std::this_thread::sleep_until(start);
+}
+
+std::size_t MemoryReader::Read(std::uintptr_t address, void* buffer, std::size_t size)
+{
+	Throttle(size);
+
+	std::size_t done = 0;
+	while (done < size)
+	{
+		ssize_t result = pread(fd, (char*)buffer + done, size - done, address + done);
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result <= 0)
+		{
+			break;
+		}
+		done += result;
+	}
+
+	return done;
+}
+
+void MemoryReader::ReadPages(std::uintptr_t regionStart, const PagemapBatch& batch, std::uint64_t mask, std::uint64_t exclude, std::vector<char>& buffer,
+	const std::function<void(std::size_t page, const char* data)>& visit)
+{
+	const std::size_t pageSize = PagemapPageSize();
+	const std::size_t maxPages = buffer.size() / pageSize;
+
+	auto wanted = [&](std::uint64_t entry)
+	{
+		return (entry & mask) == mask && !(entry & exclude);
+	};
+
+	for (std::size_t i = 0; i < batch.count; )
+	{
+		if (!wanted(batch.entries[i]))
+		{
+			++i;
+			continue;
+		}
+
+		std::size_t first = i;
+		while (i < batch.count && i - first < maxPages && wanted(batch.entries[i]))
+		{
+			++i;
+		}
+
+		std::uintptr_t address = regionStart + (batch.firstPage + first) * pageSize;
+		std::size_t read = Read(address, buffer.data(), (i - first) * pageSize);
+
+		for (std::size_t page = 0; page < read / pageSize; ++page)
+		{
+			visit(batch.firstPage + first + page, buffer.data() + page * pageSize);
+		}
+	}
+}
+
+std::size_t MemoryReader::ReadPresent(std::uintptr_t address, void* buffer, std::size_t size)
+{
+	if (size == 0)
+	{
+		return 0;
+	}
+
+	const std::size_t pageSize = PagemapPageSize();
+	std::uintptr_t firstPage = address / pageSize;
+	std::vector<std::uint64_t> entries((address + size - 1) / pageSize - firstPage + 1);
+
+	std::size_t bytes = entries.size() * sizeof(std::uint64_t);
+	if (pagemapFd < 0 || pread(pagemapFd, entries.data(), bytes, firstPage * sizeof(std::uint64_t)) != (ssize_t)bytes)
+	{
+		return 0;
+	}
+
+	std::size_t done = 0;
+	for (std::size_t i = 0; i < entries.size() && done < size; )
+	{
+		bool present = (entries[i] & PagemapPresent) != 0;
+		while (i < entries.size() && ((entries[i] & PagemapPresent) != 0) == present)
+		{
+			++i;
+		}
+
+		std::size_t end = std::min<std::size_t>((firstPage + i) * pageSize - address, size);
+		if (!present)
+		{
+			memset((char*)buffer + done, 0, end - done);
+		}
+		else if (Read(address + done, (char*)buffer + done, end - done) != end - done)
+		{
+			return done;
+		}
+		done = end;
+	}
+
+	return done;
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_MEMORY_H__
+#define VMMAP_MEMORY_H__
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+struct PagemapBatch;
+
+// Reads the memory of another process.
+// process_vm_readv() is not available to Darwin binaries, so this goes through
+// /proc/<pid>/mem, with one pread() per run of neighbouring pages.
+// All reads are paced to bytesPerSecond, shared by all threads, so that scanning
+// a production process does not steal all of its memory bandwidth.
+struct MemoryReader
+{
+	MemoryReader(int pid, std::size_t bytesPerSecond);
+	~MemoryReader();
+
+	MemoryReader(const MemoryReader&) = delete;
+	MemoryReader& operator=(const MemoryReader&) = delete;
+
+	inline bool IsOpen() const
+	{
+		return fd >= 0;
+	}
+
+	// Returns the number of bytes read, which is short if the range is
+	// (no longer) readable.
+	std::size_t Read(std::uintptr_t address, void* buffer, std::size_t size);
+
+	// Like Read(), but only reads the pages that pagemap reports present, and
+	// fills the others with zeroes, so that nothing is swapped in, and no page
+	// is faulted in. Returns 0 if the pagemap cannot be read.
+	std::size_t ReadPresent(std::uintptr_t address, void* buffer, std::size_t size);
+
+	// Reads the pages of a pagemap batch whose entries have all bits of mask and
+	// none of exclude set, merging neighbours into reads of at most buffer.size()
+	// bytes, and calls visit(page, data) for every page that could be read.
+	// page is relative to the start of the region, as in PagemapBatch.
+	void ReadPages(std::uintptr_t regionStart, const PagemapBatch& batch, std::uint64_t mask, std::uint64_t exclude, std::vector<char>& buffer,
+		const std::function<void(std::size_t page, const char* data)>& visit);
+
+private:
+	void Throttle(std::size_t size);
+
+	int fd;
+	int pagemapFd;
+	double bytesPerSecond;
+
+	std::mutex mutex;
+	std::chrono::steady_clock::time_point nextRead;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,218 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+#include "map.h"
+#include "numa.h"
+#include "snapshot.h"
+
+// One line of numa_maps, in the form of
+// "7f0c4c000000 default anon=3 dirty=3 N0=2 N1=1 kernelpagesize_kB=4".
+struct NumaRegion
+{
+	std::uintptr_t start = 0;
+	std::string policy;
+	std::vector<std::size_t> nodePages;
+	std::size_t pageSize = 0;
+};
+
+// Parses a cpulist, in the form of "0-7,16-23".
+static void ParseCpuList(const std::string& list, int node, std::vector<int>& cpuNodes)
+{
+	std::istringstream ranges(list);
+	std::string range;
+	while (std::getline(ranges, range, ','))
+	{
+		if (range.empty() || !isdigit(range[0]))
+		{
+			continue;
+		}
+
+		std::size_t dash = range.find('-');
+		int first = std::stoi(range);
+		int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+
+		if ((int)cpuNodes.size() <= last)
+		{
+			cpuNodes.resize(last + 1, -1);
+		}
+		for (int cpu = first; cpu <= last; ++cpu)
+		{
+			cpuNodes[cpu] = node;
+		}
+	}
+}
+
+std::vector<int> ReadCpuNodes()
+{
+	std::vector<int> cpuNodes;
+	std::string directory = SystemPrefix + "/sys/devices/system/node";
+
+	DIR* dir = opendir(directory.c_str());
+	if (dir == nullptr)
+	{
+		return cpuNodes;
+	}
+
+	while (dirent* item = readdir(dir))
+	{
+		if (strncmp(item->d_name, "node", 4) != 0 || !isdigit(item->d_name[4]))
+		{
+			continue;
+		}
+
+		std::ifstream file(directory + "/" + item->d_name + "/cpulist");
+		std::string list;
+		std::getline(file, list);
+		ParseCpuList(list, std::atoi(item->d_name + 4), cpuNodes);
+	}
+
+	closedir(dir);
+	return cpuNodes;
+}
+
+static std::vector<NumaRegion> ParseNumaMaps(const std::string& contents)
+{
+	std::vector<NumaRegion> regions;
+	std::istringstream lines(contents);
+	std::string line;
+
+	while (std::getline(lines, line))
+	{
+		std::istringstream tokens(line);
+		NumaRegion region;
+		std::string address;
+		if (!(tokens >> address >> region.policy))
+		{
+			continue;
+		}
+		region.start = std::stoull(address, nullptr, 16);
+
+		std::string token;
+		while (tokens >> token)
+		{
+			std::size_t equals = token.find('=');
+			if (equals == std::string::npos)
+			{
+				continue;
+			}
+
+			if (token[0] == 'N' && isdigit(token[1]))
+			{
+				std::size_t node = std::stoul(token.substr(1, equals - 1));
+				if (region.nodePages.size() <= node)
+				{
+					region.nodePages.resize(node + 1);
+				}
+				region.nodePages[node] += std::stoull(token.substr(equals + 1));
+			}
+			else if (token.compare(0, equals, "kernelpagesize_kB") == 0)
+			{
+				region.pageSize = std::stoull(token.substr(equals + 1)) * 1024;
+			}
+		}
+
+		regions.push_back(region);
+	}
+
+	return regions;
+}
+
+bool ReadNumaPlacement(VmmapSnapshot& snapshot, std::list<VmmapEntry>& entries)
+{
+	if (!snapshot.numaMaps.present)
+	{
+		return false;
+	}
+
+	std::vector<NumaRegion> regions = ParseNumaMaps(snapshot.numaMaps.Contents());
+	std::vector<int> cpuNodes = ReadCpuNodes();
+
+	std::size_t nodeCount = 0;
+	for (int node : cpuNodes)
+	{
+		nodeCount = std::max<std::size_t>(nodeCount, node + 1);
+	}
+	for (const auto& region : regions)
+	{
+		nodeCount = std::max(nodeCount, region.nodePages.size());
+	}
+
+	std::vector<bool> threadNodes(nodeCount);
+	bool anyThreadNode = false;
+	for (auto& thread : snapshot.threads)
+	{
+		if (thread.cpu >= 0 && thread.cpu < (int)cpuNodes.size() && cpuNodes[thread.cpu] >= 0)
+		{
+			thread.node = cpuNodes[thread.cpu];
+			threadNodes[thread.node] = true;
+			anyThreadNode = true;
+		}
+	}
+
+	// Both are sorted by address, with one line per region, so one pass
+	// over each is enough.
+	auto region = regions.begin();
+	for (auto& entry : entries)
+	{
+		entry.nodeBytes.assign(nodeCount, 0);
+
+		while (region != regions.end() && region->start < (std::uintptr_t)entry.startAddress)
+		{
+			++region;
+		}
+		if (region == regions.end() || region->start != (std::uintptr_t)entry.startAddress)
+		{
+			continue;
+		}
+
+		std::size_t pageSize = region->pageSize ? region->pageSize : entry.pageSize;
+		std::size_t total = 0;
+		std::size_t remote = 0;
+		for (std::size_t node = 0; node < region->nodePages.size(); ++node)
+		{
+			std::size_t bytes = region->nodePages[node] * pageSize;
+			entry.nodeBytes[node] = bytes;
+			total += bytes;
+			if (!threadNodes[node])
+			{
+				remote += bytes;
+			}
+		}
+
+		entry.numaPolicy = region->policy;
+		entry.numaRemote = anyThreadNode && remote * 2 > total;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_NUMA_H__
+#define VMMAP_NUMA_H__
+
+#include <list>
+#include <vector>
+
+struct VmmapEntry;
+struct VmmapSnapshot;
+
+// The NUMA node of every CPU, from /sys/devices/system/node/node<N>/cpulist.
+// Indexed by CPU, -1 for CPUs that are not in any node.
+std::vector<int> ReadCpuNodes();
+
+// Fills VmmapEntry::nodeBytes and numaPolicy from the numa_maps of the
+// snapshot, joined with the regions by start address, and VmmapThread::node
+// from the CPU the thread last ran on. Regions most of whose pages are on
+// nodes none of the threads run on are marked VmmapEntry::numaRemote.
+// All regions get the same number of nodes.
+// Returns false if numa_maps could not be read, which needs CONFIG_NUMA.
+bool ReadNumaPlacement(VmmapSnapshot& snapshot, std::list<VmmapEntry>& entries);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,221 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "map.h"
+#include "pagecache.h"
+
+// A run of the file that at least one region maps, with the residency of
+// every page of it.
+struct CachedRange
+{
+	std::uint64_t start;
+	std::uint64_t end;
+	std::vector<unsigned char> residency;
+};
+
+// The regions mapping one file.
+struct MappedFile
+{
+	std::string path;
+	// As in /proc/<pid>/maps: "major:minor" in hex, and the inode number.
+	std::string device;
+	std::uint64_t inode = 0;
+	std::vector<VmmapEntry*> regions;
+};
+
+// Whether st_dev is the device written as "major:minor" in /proc/<pid>/maps.
+// st_dev holds the Linux encoding of the device number.
+static bool IsSameDevice(std::uint64_t dev, const std::string& device)
+{
+	unsigned major = ((dev >> 8) & 0xfff) | ((dev >> 32) & ~0xfffu);
+	unsigned minor = (dev & 0xff) | ((dev >> 12) & ~0xffu);
+
+	char name[32];
+	snprintf(name, sizeof(name), "%02x:%02x", major, minor);
+	return device == name;
+}
+
+// mincore() takes a char vector on Darwin and an unsigned char one on Linux.
+template <typename Address, typename Vector>
+static int CallMincore(int (*function)(Address, size_t, Vector*), void* address, std::size_t size, unsigned char* residency)
+{
+	return function(address, size, (Vector*)residency);
+}
+
+// The kernel has no syscall we can use here to ask about the page cache of a
+// file without mapping it (cachestat(2) is Linux only), so we map the range
+// without touching it, and ask mincore() which pages are resident.
+static bool QueryRange(int fd, CachedRange& range)
+{
+	std::size_t size = range.end - range.start;
+	void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, range.start);
+	if (address == MAP_FAILED)
+	{
+		return false;
+	}
+
+	std::size_t pageSize = sysconf(_SC_PAGESIZE);
+	range.residency.resize((size + pageSize - 1) / pageSize);
+	bool result = CallMincore(mincore, address, size, range.residency.data()) == 0;
+
+	munmap(address, size);
+	return result;
+}
+
+static void ReadFile(const MappedFile& file)
+{
+	int fd = open(file.path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		DEBUG_PRINT("Failed to open " << file.path);
+		return;
+	}
+
+	// The path may now name another file, if the mapped one was replaced or
+	// renamed since.
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)
+		|| (std::uint64_t)info.st_ino != file.inode || !IsSameDevice((std::uint64_t)info.st_dev, file.device))
+	{
+		DEBUG_PRINT(file.path << " is no longer the mapped file");
+		close(fd);
+		return;
+	}
+
+	// Since Linux 5.0, mincore() on a file we neither own nor may write to
+	// only reports the pages mapped by ourselves, which are none. That would
+	// read as an empty cache, so such files are left unknown.
+	if (geteuid() != 0 && info.st_uid != geteuid() && access(file.path.c_str(), W_OK) != 0)
+	{
+		DEBUG_PRINT("No access to the page cache of " << file.path);
+		close(fd);
+		return;
+	}
+
+	// Merge the mapped ranges, so that a library mapped as __TEXT and
+	// __DATA, or a file mapped twice, is only queried once. Mappings can
+	// extend past the end of the file, the kernel has no pages for that.
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> mapped;
+	for (const VmmapEntry* region : file.regions)
+	{
+		std::uint64_t end = std::min<std::uint64_t>(region->offset + region->vsize, info.st_size);
+		if (region->offset < end)
+		{
+			mapped.push_back({ region->offset, end });
+		}
+	}
+	std::sort(mapped.begin(), mapped.end());
+
+	std::vector<CachedRange> ranges;
+	for (const auto& range : mapped)
+	{
+		if (!ranges.empty() && range.first <= ranges.back().end)
+		{
+			ranges.back().end = std::max(ranges.back().end, range.second);
+		}
+		else
+		{
+			ranges.push_back({ range.first, range.second, {} });
+		}
+	}
+
+	for (auto& range : ranges)
+	{
+		if (!QueryRange(fd, range))
+		{
+			DEBUG_PRINT("Failed to query the page cache of " << file.path);
+			range.residency.clear();
+		}
+	}
+
+	close(fd);
+
+	const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+	for (VmmapEntry* region : file.regions)
+	{
+		std::uint64_t start = region->offset;
+		std::uint64_t end = std::min<std::uint64_t>(region->offset + region->vsize, info.st_size);
+
+		// Every region is within exactly one merged range.
+		for (const auto& range : ranges)
+		{
+			if (start < range.start || start >= range.end || range.residency.empty())
+			{
+				continue;
+			}
+
+			region->cacheKnown = true;
+
+			std::size_t first = (start - range.start) / pageSize;
+			std::size_t last = (end - range.start + pageSize - 1) / pageSize;
+			for (std::size_t page = first; page < last; ++page)
+			{
+				if (range.residency[page] & 1)
+				{
+					region->cachedBytes += pageSize;
+				}
+			}
+			break;
+		}
+	}
+}
+
+void ReadPageCache(std::list<VmmapEntry>& entries)
+{
+	std::map<std::pair<std::string, std::uint64_t>, MappedFile> files;
+
+	for (auto& entry : entries)
+	{
+		// Anonymous memory, shared memory of the kernel, and unlinked files
+		// we cannot open again by name.
+		if (entry.inode == 0 || entry.regionDetail.find("/") == std::string::npos
+			|| entry.regionDetail.find(" (deleted)") != std::string::npos)
+		{
+			continue;
+		}
+
+		MappedFile& file = files[{ entry.device, entry.inode }];
+		file.path = entry.regionDetail;
+		file.device = entry.device;
+		file.inode = entry.inode;
+		file.regions.push_back(&entry);
+	}
+
+	for (const auto& file : files)
+	{
+		ReadFile(file.second);
+	}
+}
\ No newline at end of file
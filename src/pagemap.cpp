@@ -0,0 +1,283 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "map.h"
+#include "pagemap.h"
+#include "parallel.h"
+
+// Entries read per pread(). 128K of buffer per thread.
+static const std::size_t BatchPages = 16 * 1024;
+// Regions larger than this are split across threads. 1G with 4K pages.
+static const std::size_t ChunkPages = 256 * 1024;
+
+static_assert(BatchPages % 64 == 0 && ChunkPages % 64 == 0, "Chunks must not share bitmap words.");
+
+struct PagemapChunk
+{
+	std::size_t region;
+	std::size_t firstPage;
+	std::size_t count;
+};
+
+std::size_t PagemapPageSize()
+{
+	static const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+	return pageSize;
+}
+
+static void ReadEntries(int fd, std::uint64_t* buffer, std::size_t count, off_t offset)
+{
+	std::size_t bytes = count * sizeof(std::uint64_t);
+	std::size_t done = 0;
+
+	while (done < bytes)
+	{
+		ssize_t result = pread(fd, (char*)buffer + done, bytes - done, offset + done);
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result <= 0)
+		{
+			// Ranges the kernel refuses to describe, such as [vsyscall], read as not present.
+			memset((char*)buffer + done, 0, bytes - done);
+			return;
+		}
+		done += result;
+	}
+}
+
+bool WalkPagemap(int pid, const std::vector<const VmmapEntry*>& regions, const PagemapVisitor& visitor)
+{
+	std::string path = "/proc/" + std::to_string(pid) + "/pagemap";
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		DEBUG_PRINT("Failed to open pagemap.");
+		return false;
+	}
+
+	const std::size_t pageSize = PagemapPageSize();
+
+	std::vector<PagemapChunk> chunks;
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		std::size_t pages = (regions[i]->endAddress - regions[i]->startAddress) / pageSize;
+		for (std::size_t first = 0; first < pages; first += ChunkPages)
+		{
+			chunks.push_back({ i, first, std::min(ChunkPages, pages - first) });
+		}
+	}
+
+	// Bounded by the thread count, not by the size of the address space.
+	std::vector<std::unique_ptr<std::uint64_t[]>> buffers(WorkerCount());
+
+	try
+	{
+		ParallelFor(chunks.size(), [&](std::size_t index, unsigned worker)
+		{
+			const PagemapChunk& chunk = chunks[index];
+			if (!buffers[worker])
+			{
+				buffers[worker].reset(new std::uint64_t[BatchPages]);
+			}
+			std::uint64_t* buffer = buffers[worker].get();
+
+			std::uintptr_t regionPage = (std::uintptr_t)regions[chunk.region]->startAddress / pageSize;
+
+			for (std::size_t first = chunk.firstPage; first < chunk.firstPage + chunk.count; first += BatchPages)
+			{
+				std::size_t count = std::min(BatchPages, chunk.firstPage + chunk.count - first);
+				ReadEntries(fd, buffer, count, (regionPage + first) * sizeof(std::uint64_t));
+				visitor({ chunk.region, first, count, buffer, worker });
+			}
+		});
+	}
+	catch (...)
+	{
+		close(fd);
+		throw;
+	}
+
+	close(fd);
+	return true;
+}
+
+bool CollectPfns(int pid, const std::vector<const VmmapEntry*>& regions, std::vector<PfnKey>& keys)
+{
+	if (regions.size() >= (1u << PfnKeyRegionBits))
+	{
+		return false;
+	}
+
+	// One list per thread, merged afterwards, so the walk needs no locks.
+	std::vector<std::vector<PfnKey>> perWorker(WorkerCount());
+	std::atomic<bool> hiddenPfns(false);
+
+	bool result = WalkPagemap(pid, regions, [&](const PagemapBatch& batch)
+	{
+		std::vector<PfnKey>& list = perWorker[batch.worker];
+		for (std::size_t i = 0; i < batch.count; ++i)
+		{
+			std::uint64_t entry = batch.entries[i];
+			if (!(entry & PagemapPresent))
+			{
+				continue;
+			}
+
+			// PFNs beyond 2^40 (4P of RAM) do not fit in a key.
+			std::uint64_t pfn = PagemapPfn(entry);
+			if (pfn == 0 || (pfn >> (64 - PfnKeyRegionBits)) != 0)
+			{
+				hiddenPfns = true;
+				continue;
+			}
+			list.push_back((pfn << PfnKeyRegionBits) | batch.region);
+		}
+	});
+
+	if (!result || hiddenPfns)
+	{
+		return false;
+	}
+
+	keys.clear();
+	for (auto& list : perWorker)
+	{
+		keys.insert(keys.end(), list.begin(), list.end());
+		std::vector<PfnKey>().swap(list);
+	}
+	std::sort(keys.begin(), keys.end());
+
+	return true;
+}
+
+static std::size_t CountBits(const std::vector<std::uint64_t>& bitmap)
+{
+	std::size_t count = 0;
+	for (std::uint64_t word : bitmap)
+	{
+		count += __builtin_popcountll(word);
+	}
+	return count;
+}
+
+bool ReadPageStates(int pid, bool smapsCounters, std::list<VmmapEntry>& entries)
+{
+	const std::size_t pageSize = PagemapPageSize();
+
+	std::vector<const VmmapEntry*> regions;
+	std::vector<std::shared_ptr<VmmapPageStates>> states;
+
+	for (auto& entry : entries)
+	{
+		auto state = std::make_shared<VmmapPageStates>();
+		state->pages = (entry.endAddress - entry.startAddress) / pageSize;
+		entry.pageStates = state;
+
+		// Guard pages, ---p reservations and untouched noreserve heaps (JVM,
+		// Go arenas, sanitizer shadows) can span terabytes. When smaps says
+		// nothing is resident or swapped, their counts are all zero, and their
+		// bitmaps stay empty.
+		if (smapsCounters && entry.rss == 0 && entry.swap == 0)
+		{
+			continue;
+		}
+
+		std::size_t words = (state->pages + 63) / 64;
+		state->present.resize(words);
+		state->swapped.resize(words);
+		state->exclusive.resize(words);
+		state->softDirty.resize(words);
+		state->file.resize(words);
+
+		regions.push_back(&entry);
+		states.push_back(state);
+	}
+
+	bool result = WalkPagemap(pid, regions, [&](const PagemapBatch& batch)
+	{
+		VmmapPageStates& state = *states[batch.region];
+
+		for (std::size_t i = 0; i < batch.count; ++i)
+		{
+			std::uint64_t entry = batch.entries[i];
+			if (entry == 0)
+			{
+				continue;
+			}
+
+			std::size_t page = batch.firstPage + i;
+			std::uint64_t bit = 1ull << (page % 64);
+			std::size_t word = page / 64;
+
+			if (entry & PagemapPresent)
+			{
+				state.present[word] |= bit;
+			}
+			if (entry & PagemapSwapped)
+			{
+				state.swapped[word] |= bit;
+			}
+			if (entry & PagemapExclusive)
+			{
+				state.exclusive[word] |= bit;
+			}
+			if (entry & PagemapSoftDirty)
+			{
+				state.softDirty[word] |= bit;
+			}
+			if (entry & PagemapFile)
+			{
+				state.file[word] |= bit;
+			}
+		}
+	});
+
+	if (!result)
+	{
+		return false;
+	}
+
+	for (auto& state : states)
+	{
+		state->presentCount = CountBits(state->present);
+		state->swappedCount = CountBits(state->swapped);
+		state->exclusiveCount = CountBits(state->exclusive);
+		state->softDirtyCount = CountBits(state->softDirty);
+		state->fileCount = CountBits(state->file);
+	}
+
+	return true;
+}
\ No newline at end of file
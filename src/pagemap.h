@@ -0,0 +1,139 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_PAGEMAP_H__
+#define VMMAP_PAGEMAP_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <vector>
+
+struct VmmapEntry;
+
+// Layout of a /proc/<pid>/pagemap entry.
+// See Documentation/admin-guide/mm/pagemap.rst in the Linux tree.
+const std::uint64_t PagemapPresent = 1ull << 63;
+const std::uint64_t PagemapSwapped = 1ull << 62;
+const std::uint64_t PagemapFile = 1ull << 61;
+const std::uint64_t PagemapExclusive = 1ull << 56;
+const std::uint64_t PagemapSoftDirty = 1ull << 55;
+const std::uint64_t PagemapPfnMask = (1ull << 55) - 1;
+
+// Only meaningful for present pages. Reads as 0 without CAP_SYS_ADMIN.
+inline std::uint64_t PagemapPfn(std::uint64_t entry)
+{
+	return entry & PagemapPfnMask;
+}
+
+// Only meaningful for swapped pages.
+inline unsigned PagemapSwapType(std::uint64_t entry)
+{
+	return entry & 0x1f;
+}
+
+inline std::uint64_t PagemapSwapOffset(std::uint64_t entry)
+{
+	return (entry & PagemapPfnMask) >> 5;
+}
+
+// A run of consecutive pagemap entries, all belonging to one region.
+struct PagemapBatch
+{
+	// Index into the region list given to WalkPagemap().
+	std::size_t region;
+	// Relative to the start of the region.
+	std::size_t firstPage;
+	std::size_t count;
+	const std::uint64_t* entries;
+	// The thread calling the visitor, see ParallelFor().
+	unsigned worker;
+};
+
+typedef std::function<void(const PagemapBatch&)> PagemapVisitor;
+
+// Page-level state of one region, one bit per page.
+// Bit i of a bitmap describes the page at startAddress + i * PagemapPageSize(),
+// also in hugetlb regions, so the counts are always in base pages. The bitmaps
+// are empty for inaccessible regions that hold no pages.
+struct VmmapPageStates
+{
+	std::size_t pages = 0;
+
+	std::vector<std::uint64_t> present;
+	std::vector<std::uint64_t> swapped;
+	std::vector<std::uint64_t> exclusive;
+	std::vector<std::uint64_t> softDirty;
+	std::vector<std::uint64_t> file;
+
+	std::size_t presentCount = 0;
+	std::size_t swappedCount = 0;
+	std::size_t exclusiveCount = 0;
+	std::size_t softDirtyCount = 0;
+	std::size_t fileCount = 0;
+
+	static inline bool Test(const std::vector<std::uint64_t>& bitmap, std::size_t page)
+	{
+		return (bitmap[page / 64] >> (page % 64)) & 1;
+	}
+};
+
+// pagemap is always indexed by the base page size, even for hugetlb regions.
+std::size_t PagemapPageSize();
+
+// Reads the pagemap entries of all regions in large batches, on a pool of threads.
+// Large regions are split into chunks, so the visitor may run concurrently for
+// the same region, but each page is visited exactly once. Chunks always start at
+// a multiple of 64 pages into their region, so per-region bitmaps can be written
+// from the visitor without locking.
+// Returns false if the pagemap of the process cannot be opened.
+bool WalkPagemap(int pid, const std::vector<const VmmapEntry*>& regions, const PagemapVisitor& visitor);
+
+// A present page, as PFN << PfnKeyRegionBits | index of its region.
+// Sorting the keys sorts by PFN, so that per-PFN files of the kernel
+// (kpagecount, kpageflags, page_idle/bitmap) can be read front to back.
+typedef std::uint64_t PfnKey;
+const int PfnKeyRegionBits = 24;
+
+inline std::uint64_t PfnKeyPfn(PfnKey key)
+{
+	return key >> PfnKeyRegionBits;
+}
+
+inline std::size_t PfnKeyRegion(PfnKey key)
+{
+	return key & ((1u << PfnKeyRegionBits) - 1);
+}
+
+// Collects the PFN of every present page of the regions, sorted.
+// Returns false if the pagemap cannot be read, or if the PFNs are hidden,
+// which they are without CAP_SYS_ADMIN.
+bool CollectPfns(int pid, const std::vector<const VmmapEntry*>& regions, std::vector<PfnKey>& keys);
+
+// Fills VmmapEntry::pageStates for every region.
+// With smapsCounters, regions whose smaps Rss and Swap are both zero are not
+// walked, and get empty bitmaps.
+// Returns false if the pagemap of the process cannot be opened.
+bool ReadPageStates(int pid, bool smapsCounters, std::list<VmmapEntry>& entries);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,132 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "map.h"
+#include "pagemap.h"
+#include "pagetables.h"
+#include "parallel.h"
+
+// A table of the lowest level, as the index of the range it maps
+// << SpanKeyRegionBits | index of the region. Sorting the keys sorts by
+// address, and for every range, the lowest region comes first.
+typedef std::uint64_t SpanKey;
+static const int SpanKeyRegionBits = 24;
+
+// The levels above the last one, PMD and PUD. PGD is allocated with the mm
+// and not counted in VmPTE.
+static const int UpperLevels = 2;
+
+bool EstimatePageTables(int pid, std::list<VmmapEntry>& entries)
+{
+	const std::size_t pageSize = PagemapPageSize();
+	// Entries are 8 bytes on every 64 bit architecture we run on.
+	const std::size_t entriesPerTable = pageSize / sizeof(std::uint64_t);
+
+	std::vector<VmmapEntry*> regions;
+	std::vector<const VmmapEntry*> constRegions;
+	for (auto& entry : entries)
+	{
+		entry.pageTableBytes = 0;
+		regions.push_back(&entry);
+		constRegions.push_back(&entry);
+	}
+
+	if (regions.size() >= (1u << SpanKeyRegionBits))
+	{
+		return false;
+	}
+
+	std::vector<std::vector<SpanKey>> keys(WorkerCount());
+
+	bool result = WalkPagemap(pid, constRegions, [&](const PagemapBatch& batch)
+	{
+		std::vector<SpanKey>& list = keys[batch.worker];
+		std::uint64_t regionPage = (std::uintptr_t)regions[batch.region]->startAddress / pageSize;
+		std::uint64_t lastSpan = UINT64_MAX;
+
+		for (std::size_t i = 0; i < batch.count; ++i)
+		{
+			// Present, swapped, or a migration entry (which pagemap reports
+			// as swapped): all need a PTE. Other bits mean nothing here,
+			// soft-dirty is also set on holes.
+			if (!(batch.entries[i] & (PagemapPresent | PagemapSwapped)))
+			{
+				continue;
+			}
+
+			std::uint64_t span = (regionPage + batch.firstPage + i) / entriesPerTable;
+			if (span != lastSpan)
+			{
+				list.push_back((span << SpanKeyRegionBits) | batch.region);
+				lastSpan = span;
+			}
+		}
+	});
+
+	if (!result)
+	{
+		return false;
+	}
+
+	std::vector<SpanKey> all;
+	for (const auto& list : keys)
+	{
+		all.insert(all.end(), list.begin(), list.end());
+	}
+	std::sort(all.begin(), all.end());
+
+	// Lowest level, then one pass per upper level over the same keys, with
+	// ranges entriesPerTable times larger.
+	std::vector<std::size_t> tables(regions.size());
+	std::uint64_t shift = 1;
+	for (int level = 0; level <= UpperLevels; ++level)
+	{
+		std::uint64_t lastRange = UINT64_MAX;
+		for (SpanKey key : all)
+		{
+			std::uint64_t range = (key >> SpanKeyRegionBits) / shift;
+			if (range != lastRange)
+			{
+				++tables[key & ((1u << SpanKeyRegionBits) - 1)];
+				lastRange = range;
+			}
+		}
+		shift *= entriesPerTable;
+	}
+
+	const std::size_t hugePageSize = pageSize * entriesPerTable;
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		// THP mapped by a PMD need no table below it. pagemap shows their pages
+		// as present like any other, so take them out by size.
+		std::size_t thpTables = regions[i]->thpBytes / hugePageSize;
+		tables[i] -= std::min(tables[i], thpTables);
+
+		regions[i]->pageTableBytes = tables[i] * pageSize;
+	}
+
+	return true;
+}
\ No newline at end of file
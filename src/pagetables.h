@@ -0,0 +1,38 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_PAGETABLES_H__
+#define VMMAP_PAGETABLES_H__
+
+#include <list>
+
+struct VmmapEntry;
+
+// Estimates the page tables the kernel needs for the process, from which
+// ranges of the pagemap are populated, into VmmapEntry::pageTableBytes.
+// A table at any level exists if one entry below it is populated. Every
+// table is charged to the lowest region it covers, so that the regions add
+// up to the total, which is comparable with VmPTE in /proc/<pid>/status.
+// Returns false if the pagemap of the process cannot be opened.
+bool EstimatePageTables(int pid, std::list<VmmapEntry>& entries);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,86 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "parallel.h"
+
+// More threads than this mostly fight over the target's mm locks.
+static const unsigned MaxWorkers = 8;
+
+unsigned WorkerCount()
+{
+	unsigned count = std::thread::hardware_concurrency();
+	return std::max(1u, std::min(count, MaxWorkers));
+}
+
+void ParallelFor(std::size_t count, const std::function<void(std::size_t index, unsigned worker)>& work)
+{
+	unsigned workers = (unsigned)std::min<std::size_t>(WorkerCount(), count);
+
+	std::atomic<std::size_t> next(0);
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	auto run = [&](unsigned worker)
+	{
+		try
+		{
+			for (std::size_t index = next++; index < count; index = next++)
+			{
+				work(index, worker);
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if (!error)
+			{
+				error = std::current_exception();
+			}
+			// Make the others stop early.
+			next = count;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned worker = 1; worker < workers; ++worker)
+	{
+		threads.emplace_back(run, worker);
+	}
+	run(0);
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
\ No newline at end of file
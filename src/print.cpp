@@ -23,13 +23,20 @@
 // To-Do: Clean up this file, so that the printing logic and the 
 // system information fetching logic are separated.
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <ctime>
+#include <functional>
 #include <iomanip>
+#include <fstream>
 #include <iostream>
 #include <list>
+#include <map>
+#include <set>
+#include <sstream>
 #include <unordered_map>
+#include <vector>
 
 #include <err.h>
 #include <dlfcn.h>
@@ -42,16 +49,33 @@
 #include <CoreFoundation/CoreFoundation.h>
 
 #include "args.h"
+#include "commit.h"
+#include "fragmentation.h"
 #include "debug.h"
+#include "duplicates.h"
+#include "family.h"
+#include "hugepages.h"
 #include "map.h"
+#include "pagemap.h"
 #include "print.h"
+#include "snapshot.h"
+#include "swap.h"
+#include "text.h"
 
-static void PrintOverview(const std::list<VmmapEntry>& entries, const VmmapArgs& args);
+static std::unordered_map<std::string, VmmapSummaryEntry> SummarizeRegions(const std::list<VmmapEntry>& entries);
+static void PrintOverview(const std::list<VmmapEntry>& entries, const std::unordered_map<std::string, VmmapSummaryEntry>& regions, const VmmapArgs& args, const VmmapSnapshot& snapshot);
 static void PrintCore(const std::list<VmmapEntry>& entries, const VmmapArgs& args);
-static void PrintSummary(const std::list<VmmapEntry>& entries, const VmmapArgs& args);
+static void PrintSummary(const std::list<VmmapEntry>& entries, const std::unordered_map<std::string, VmmapSummaryEntry>& regions, const VmmapArgs& args, const VmmapSnapshot& snapshot);
 static void PrintMalloc(const std::list<VmmapEntry>& entries, const VmmapArgs& args);
+static void PrintPageStates(const std::list<VmmapEntry>& entries, const VmmapArgs& args);
+static void PrintZeroPages(const std::list<VmmapEntry>& entries, const VmmapArgs& args);
+static void PrintNumaThreads(const std::list<VmmapEntry>& entries, const VmmapArgs& args, const VmmapSnapshot& snapshot);
+static void PrintPageCache(const std::list<VmmapEntry>& entries, const VmmapArgs& args);
+static void PrintThreadStacks(const std::list<VmmapEntry>& entries, const VmmapArgs& args, const VmmapSnapshot& snapshot);
+static void PrintFragmentation(const std::list<VmmapEntry>& entries, const VmmapArgs& args);
 
 static std::string GetProcessName(int pid);
+inline static std::string FormatData(std::intptr_t bytes, std::string sep);
 
 
 void PrintHelp()
@@ -59,12 +83,12 @@ void PrintHelp()
 	const int arg_width = 15;
 
 	std::cout << "vmmap: Gives you an indication of the VM used by a process\n";
-	std::cout << "Usage: vmmap [-wide] [-pages] [-interleaved] [-submap] [-allSplitLibs] [-noCoalesce] [-summary] [-stacks] [-forkCorpse] <pid | partial-process-name | memory-graph-file> [<address>]\n";
+	std::cout << "Usage: vmmap [-wide] [-pages] [-interleaved] [-submap] [-allSplitLibs] [-noCoalesce] [-summary] [-stacks] [-forkCorpse] [-preciseSharing] [-zeropages] [-duplicates] [-compressibility] [-workingset <seconds>] [-damon <seconds>] [-writes <seconds>] [-hugepages] [-numa] [-pagecache] [-text] [-swap] [-ksm] [-commit] [-pagetables] [-pss] [-threadstacks] [-fragmentation] [-arenas] [-faults <seconds>] [-faultInterval <ms>] [-scanRate <MB/s>] <pid | partial-process-name | memory-graph-file> [<pid>...] [<address>]\n";
 	std::cout << "\n";
 #define PRINT_OPTION(name, description) std::cout << "\t" << std::left << std::setw(arg_width) << name << description << "\n";
 	PRINT_OPTION("-w/-wide", "print wide output");
 	PRINT_OPTION("-v/-verbose", "equivalent to -w -submap -allSplitLibs -noCoalesce");
-	PRINT_OPTION("-pages", "print region sizes in page counts rather than kilobytes");
+	PRINT_OPTION("-pages", "print region sizes in page counts rather than kilobytes, with exact resident and swapped counts from pagemap");
 	PRINT_OPTION("-interleaved", "print all regions in order, rather than non-writable then writable");
 	PRINT_OPTION("-submap", "print info about submaps");
 	PRINT_OPTION("-allSplitLibs", "print info about all system split libraries, even those not loaded by this process");
@@ -72,24 +96,47 @@ void PrintHelp()
 	PRINT_OPTION("-summary", "only print overall summary, not individual regions");
     PRINT_OPTION("-stacks", "show region allocation backtraces if target process uses MallocStackLogging (implies -interleaved -noCoalesce)");
 	PRINT_OPTION("-fullStacks", "show region allocation backtraces with one line per frame");
-	PRINT_OPTION("-forkCorpse", "generate a corpse fork from process and run vmmap on it");
+	PRINT_OPTION("-forkCorpse", "freeze the process while its memory map is captured, so that the output is a consistent snapshot");
+	PRINT_OPTION("-zeropages", "find resident pages of writable private regions that hold only zeroes");
+	PRINT_OPTION("-duplicates", "find exclusively mapped anonymous pages that are identical to another one, as KSM would merge them");
+	PRINT_OPTION("-compressibility", "estimate how well private anonymous memory would compress in zram, from a random sample of pages");
+	PRINT_OPTION("-workingset <seconds>", "mark resident pages idle, wait, and show which of them were accessed in the meantime");
+	PRINT_OPTION("-damon <seconds>", "monitor the process with DAMON, and split every region into hot, warm and cold memory by access frequency");
+	PRINT_OPTION("-writes <seconds>", "clear the soft-dirty bits of the process, wait, and show how much of every writable region was written, and how fast");
+	PRINT_OPTION("-hugepages", "show THP and hugetlb memory of every region, and how much of it could be backed by transparent huge pages");
+	PRINT_OPTION("-numa", "show resident memory per NUMA node, flag regions that are mostly remote to the threads, and where every thread runs");
+	PRINT_OPTION("-pagecache", "show how much of every mapped file is in the page cache, including pages this process does not map");
+	PRINT_OPTION("-text", "show the code footprint of every binary, and how much of it huge pages could cover (iTLB pressure)");
+	PRINT_OPTION("-swap", "split swapped memory by swap area, to tell zram from disk swap");
+	PRINT_OPTION("-ksm", "show memory merged by KSM per region, and what writing to it would cost");
+	PRINT_OPTION("-commit", "show the commit charge and locked memory of every region, against the limits of the system and the process");
+	PRINT_OPTION("-pagetables", "estimate the page tables every region needs, and compare their sum with VmPTE");
+	PRINT_OPTION("-pss", "show the proportional set size of every region, split into anonymous, file and shmem pages");
+	PRINT_OPTION("-threadstacks", "show how deep the stack of every thread ever got, against its reserved size");
+	PRINT_OPTION("-fragmentation", "show the free holes of the address space, guard pages, and a histogram of region and hole sizes");
+	PRINT_OPTION("-arenas", "walk the glibc malloc arenas to fill in the MALLOC ZONE table, one zone per arena. Only resident pages are read, so a walk stops at the first swapped out page of a heap");
+	PRINT_OPTION("-faults", "sample the pagemap for this many seconds, and attribute the pages faulted in meanwhile to regions. One fault can bring in many pages (a THP, or fault-around of a file), so these are page counts, printed next to the fault counters of the process");
+	PRINT_OPTION("-faultInterval", "how often -faults samples the pagemap, in milliseconds (default 1000); shorter catches more, at a higher cost");
+	PRINT_OPTION("-scanRate <MB/s>", "limit how fast the memory of the process is read (default 256, 0 for no limit)");
+	PRINT_OPTION("-preciseSharing", "compute sharing modes from the system wide map count of every resident page (needs root)");
 #undef PRINT_OPTION
+	std::cout << "\n";
+	std::cout << "When several pids are given, each one is reported in turn, followed by the memory they share with each other (needs root).\n";
 }
 
-void Print(const std::list<VmmapEntry>& entries, const VmmapArgs& args)
+void Print(const std::list<VmmapEntry>& entries, const VmmapArgs& args, const VmmapSnapshot& snapshot)
 {
-	if (args.forkCorpse)
-	{
-		throw new std::invalid_argument("vmmap: -forkCorpse not implemented");
-	}
+	// One pass over the regions, for the footprint in the overview and the
+	// summary table.
+	const std::unordered_map<std::string, VmmapSummaryEntry> regions = SummarizeRegions(entries);
 
-	PrintOverview(entries, args);
+	PrintOverview(entries, regions, args, snapshot);
 
 	if (!args.summary)
 	{
 		std::cout << "Virtual Memory Map of process " << args.pid << " (" << GetProcessName(args.pid) << ")\n";
 		std::cout << "Output report format: 0.0\n";
-		std::cout << "VM page size: " << entries.begin()->pageSize << " bytes\n";
+		std::cout << "VM page size: " << PagemapPageSize() << " bytes\n";
 		std::cout << std::endl;
 
 		if (!args.interleaved)
@@ -131,10 +178,41 @@ void Print(const std::list<VmmapEntry>& entries, const VmmapArgs& args)
         			<< "\t\tSHM=shared ZER=zero_filled S/A=shared_alias\n"
 					<< "PURGE=purgeable mode:\n"
         			<< "\t\tV=volatile N=nonvolatile E=empty   otherwise is unpurgeable\n"
+        			<< "\t\t(V: some pages freed with MADV_FREE, E: all resident pages freed with MADV_FREE)\n"
 					<< std::endl;
 	}
 
-	PrintSummary(entries, args);
+	PrintSummary(entries, regions, args, snapshot);
+
+	if (args.fragmentation)
+	{
+		PrintFragmentation(entries, args);
+	}
+
+	if (args.pages && entries.front().pageStates)
+	{
+		PrintPageStates(entries, args);
+	}
+
+	if (args.zeroPages)
+	{
+		PrintZeroPages(entries, args);
+	}
+
+	if (args.numa)
+	{
+		PrintNumaThreads(entries, args, snapshot);
+	}
+
+	if (args.pageCache)
+	{
+		PrintPageCache(entries, args);
+	}
+
+	if (args.threadStacks)
+	{
+		PrintThreadStacks(entries, args, snapshot);
+	}
 }
 
 static std::string GetProcessName(int pid)
@@ -212,7 +290,7 @@ static std::string GetMacOSInfo()
 	return result;
 }
 
-static void PrintOverview(const std::list<VmmapEntry>& entries, const VmmapArgs& args)
+static void PrintOverview(const std::list<VmmapEntry>& entries, const std::unordered_map<std::string, VmmapSummaryEntry>& regions, const VmmapArgs& args, const VmmapSnapshot& snapshot)
 {
 	proc_taskallinfo info;
 	int size = sizeof(info);
@@ -264,10 +342,50 @@ static void PrintOverview(const std::list<VmmapEntry>& entries, const VmmapArgs&
 	std::cout << std::left << std::setw(30) << "Report Version:" << 0 << std::endl;
 	std::cout << std::left << std::setw(30) << "Analysis Tool:" << GetProcessPath(getpid()) << std::endl;
 	std::cout << std::left << std::setw(30) << "Analysis Tool Version:" << __DATE__ << " " << __TIME__ << std::endl;
+	if (snapshot.frozen)
+	{
+		// There are no corpses on Linux. The target was stopped instead, for as short as possible.
+		std::ostringstream duration;
+		duration << std::fixed << std::setprecision(3) << snapshot.freezeDuration.count() / 1000.0;
+		std::cout << std::left << std::setw(30) << "Corpse:" << "frozen with " << snapshot.freezeMethod << " for "
+			<< duration.str() << " ms" << std::endl;
+	}
 	std::cout << std::endl;
 
-	std::cout << std::left << std::setw(30) << "Physical footprint:" << "???" << std::endl;
-	std::cout << std::left << std::setw(30) << "Physical footprint (peak):" << "???" << std::endl;
+	std::intptr_t footprint = 0;
+	for (const auto & kvp : regions)
+	{
+		footprint += kvp.second.footprint;
+	}
+
+	// Linux only keeps the peak RSS. What was resident at the peak and is no
+	// longer is mostly freed heap, so it is counted as footprint as well.
+	std::intptr_t peakRss = -1;
+	std::intptr_t rss = -1;
+	std::istringstream status(snapshot.status.Contents());
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.compare(0, 6, "VmHWM:") == 0)
+		{
+			peakRss = std::stoll(line.substr(6)) * 1024;
+		}
+		else if (line.compare(0, 6, "VmRSS:") == 0)
+		{
+			rss = std::stoll(line.substr(6)) * 1024;
+		}
+	}
+
+	std::cout << std::left << std::setw(30) << "Physical footprint:" << FormatData(footprint, "") << std::endl;
+	std::cout << std::left << std::setw(30) << "Physical footprint (peak):";
+	if (peakRss >= 0 && rss >= 0)
+	{
+		std::cout << FormatData(footprint + std::max<std::intptr_t>(peakRss - rss, 0), "") << std::endl;
+	}
+	else
+	{
+		std::cout << "???" << std::endl;
+	}
 	std::cout << "----" << std::endl;
 	std::cout << std::endl;
 }
@@ -339,8 +457,437 @@ inline static std::string PagesOrKilobytes(std::size_t bytes, std::size_t pageSi
 	return FormatData(bytes);
 }
 
+// Optional columns, shown in the region list and the summary table when
+// the analysis that fills them was asked for.
+struct CoreColumn
+{
+	std::string header;
+	int width;
+	std::function<std::string(const VmmapEntry&)> value;
+};
+
+struct SummaryColumn
+{
+	std::string header;
+	std::string subheader;
+	int width;
+	std::function<std::string(const VmmapSummaryEntry&)> value;
+};
+
+inline static std::string Ratio(double original, double compressed)
+{
+	if (original <= 0)
+	{
+		return "-";
+	}
+	if (compressed * 99 < original)
+	{
+		return ">99x";
+	}
+
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(1) << original / compressed << "x";
+	return ss.str();
+}
+
+inline static std::string Rate(std::size_t count, std::size_t seconds)
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(1) << (double)count / seconds;
+	return ss.str();
+}
+
+static std::vector<CoreColumn> GetCoreColumns(const VmmapArgs& args, std::size_t nodeCount)
+{
+	std::vector<CoreColumn> columns;
+
+	if (args.compressibility)
+	{
+		columns.push_back({ "COMPR", 7, [&args](const VmmapEntry& entry)
+		{
+			return entry.compressionSamples ? PagesOrKilobytes((std::size_t)entry.compressedBytes, entry.pageSize, args.pages) : std::string("-");
+		}});
+		columns.push_back({ "RATIO", 6, [](const VmmapEntry& entry)
+		{
+			return entry.compressionSamples ? Ratio((double)entry.compressiblePages * PagemapPageSize(), entry.compressedBytes) : std::string("-");
+		}});
+	}
+
+	if (args.workingSetSeconds != 0)
+	{
+		columns.push_back({ "ACCESSED", 8, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.accessedPages * PagemapPageSize(), entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "IDLE", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.idlePages * PagemapPageSize(), entry.pageSize, args.pages);
+		}});
+	}
+
+	if (args.damonSeconds != 0)
+	{
+		columns.push_back({ "HOT", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.hotBytes, entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "WARM", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.warmBytes, entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "COLD", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.coldBytes, entry.pageSize, args.pages);
+		}});
+	}
+
+	if (args.writeSeconds != 0)
+	{
+		columns.push_back({ "WRITTEN", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.writtenPages * PagemapPageSize(), entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "WRITE/S", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.writtenPages * PagemapPageSize() / args.writeSeconds, entry.pageSize, args.pages);
+		}});
+	}
+
+	if (args.faultSeconds != 0)
+	{
+		columns.push_back({ "ANON IN", 7, [](const VmmapEntry& entry)
+		{
+			return std::to_string(entry.anonPagesIn);
+		}});
+		columns.push_back({ "SWAP IN", 7, [](const VmmapEntry& entry)
+		{
+			return std::to_string(entry.swapPagesIn);
+		}});
+		columns.push_back({ "FILE IN", 7, [](const VmmapEntry& entry)
+		{
+			return std::to_string(entry.filePagesIn);
+		}});
+		columns.push_back({ "IN/S", 7, [&args](const VmmapEntry& entry)
+		{
+			return Rate(entry.anonPagesIn + entry.swapPagesIn + entry.filePagesIn, args.faultSeconds);
+		}});
+	}
+
+	if (args.hugePages)
+	{
+		columns.push_back({ "THP", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.thpBytes, entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "ELIGIBLE", 8, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.thpEligibleBytes, entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "HUGETLB", 7, [&args](const VmmapEntry& entry)
+		{
+			return entry.hugetlb ? PagesOrKilobytes(entry.hugetlbBytes, entry.pageSize, args.pages) : std::string("-");
+		}});
+		columns.push_back({ "ADV", 3, [](const VmmapEntry& entry)
+		{
+			return entry.thpAdvice;
+		}});
+	}
+
+	if (args.pageCache)
+	{
+		columns.push_back({ "CACHED", 7, [&args](const VmmapEntry& entry)
+		{
+			if (entry.inode == 0)
+			{
+				return std::string("-");
+			}
+			return entry.cacheKnown ? PagesOrKilobytes(entry.cachedBytes, entry.pageSize, args.pages) : std::string("???");
+		}});
+	}
+
+	if (args.commit)
+	{
+		columns.push_back({ "CHARGE", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.CommitCharge(), entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "LOCKED", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.locked, entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "ACCT", 8, [](const VmmapEntry& entry)
+		{
+			std::string flags;
+			for (const auto& flag : { std::make_pair(entry.accountable, "ac"), std::make_pair(entry.noReserve, "nr"), std::make_pair(entry.lockedRegion, "lo") })
+			{
+				if (flag.first)
+				{
+					flags += (flags.empty() ? "" : " ") + std::string(flag.second);
+				}
+			}
+			return flags;
+		}});
+	}
+
+	if (args.pageTables)
+	{
+		columns.push_back({ "PGTABLE", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.pageTableBytes, entry.pageSize, args.pages);
+		}});
+	}
+
+	if (args.ksm)
+	{
+		columns.push_back({ "KSM", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.ksmBytes, entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "MG", 2, [](const VmmapEntry& entry)
+		{
+			return std::string(entry.ksmMergeable ? "mg" : "");
+		}});
+	}
+
+	if (args.pss)
+	{
+		columns.push_back({ "PSS", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.pss, entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "PSSDRTY", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.pssDirty, entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "PSSANON", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.pssAnon, entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "PSSFILE", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.pssFile, entry.pageSize, args.pages);
+		}});
+		columns.push_back({ "PSSSHM", 7, [&args](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.pssShmem, entry.pageSize, args.pages);
+		}});
+	}
+
+	if (args.swapDevices)
+	{
+		std::vector<VmmapSwapDevice> devices = ReadSwapDevices();
+		for (std::size_t device = 0; device < devices.size(); ++device)
+		{
+			// Areas often share a prefix (swapfile, swapfile2), so widen the
+			// column to the name rather than truncating it.
+			std::string name = devices[device].ShortName();
+			int width = std::max(7, (int)name.size());
+			columns.push_back({ name, width, [&args, device](const VmmapEntry& entry)
+			{
+				return PagesOrKilobytes((device < entry.swapDeviceBytes.size()) ? entry.swapDeviceBytes[device] : 0, entry.pageSize, args.pages);
+			}});
+		}
+	}
+
+	for (std::size_t node = 0; node < nodeCount; ++node)
+	{
+		columns.push_back({ "N" + std::to_string(node), 7, [&args, node](const VmmapEntry& entry)
+		{
+			return PagesOrKilobytes(entry.nodeBytes[node], entry.pageSize, args.pages);
+		}});
+	}
+	if (args.numa)
+	{
+		columns.push_back({ "REMOTE", 6, [](const VmmapEntry& entry)
+		{
+			return std::string(entry.numaRemote ? "yes" : "");
+		}});
+	}
+
+	return columns;
+}
+
+static std::vector<SummaryColumn> GetSummaryColumns(const VmmapArgs& args, std::size_t pageSize, std::size_t nodeCount)
+{
+	std::vector<SummaryColumn> columns;
+
+	if (args.compressibility)
+	{
+		columns.push_back({ "COMPRESSED", (args.pages) ? "PAGES" : "SIZE", 10, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes((std::size_t)entry.compressed, pageSize, args.pages);
+		}});
+		columns.push_back({ "COMPR", "RATIO", 6, [](const VmmapSummaryEntry& entry)
+		{
+			return Ratio((double)entry.compressible, entry.compressed);
+		}});
+	}
+
+	if (args.workingSetSeconds != 0)
+	{
+		columns.push_back({ "ACCESSED", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.accessed, pageSize, args.pages);
+		}});
+		columns.push_back({ "IDLE", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.idle, pageSize, args.pages);
+		}});
+	}
+
+	if (args.damonSeconds != 0)
+	{
+		columns.push_back({ "HOT", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.hot, pageSize, args.pages);
+		}});
+		columns.push_back({ "WARM", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.warm, pageSize, args.pages);
+		}});
+		columns.push_back({ "COLD", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.cold, pageSize, args.pages);
+		}});
+	}
+
+	if (args.writeSeconds != 0)
+	{
+		columns.push_back({ "WRITTEN", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.written, pageSize, args.pages);
+		}});
+		columns.push_back({ "WRITE", "RATE/S", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.written / args.writeSeconds, pageSize, args.pages);
+		}});
+	}
+
+	if (args.faultSeconds != 0)
+	{
+		columns.push_back({ "PAGES IN", "ANON", 8, [](const VmmapSummaryEntry& entry)
+		{
+			return std::to_string(entry.anonPagesIn);
+		}});
+		columns.push_back({ "PAGES IN", "SWAP", 8, [](const VmmapSummaryEntry& entry)
+		{
+			return std::to_string(entry.swapPagesIn);
+		}});
+		columns.push_back({ "PAGES IN", "FILE", 8, [](const VmmapSummaryEntry& entry)
+		{
+			return std::to_string(entry.filePagesIn);
+		}});
+		columns.push_back({ "PAGES IN", "RATE/S", 8, [&args](const VmmapSummaryEntry& entry)
+		{
+			return Rate(entry.anonPagesIn + entry.swapPagesIn + entry.filePagesIn, args.faultSeconds);
+		}});
+	}
+
+	if (args.hugePages)
+	{
+		columns.push_back({ "THP", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.thp, pageSize, args.pages);
+		}});
+		columns.push_back({ "ELIGIBLE", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.thpEligible, pageSize, args.pages);
+		}});
+		columns.push_back({ "HUGETLB", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.hugetlb, pageSize, args.pages);
+		}});
+	}
+
+	if (args.pageCache)
+	{
+		columns.push_back({ "CACHED", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return (entry.cachedUnknown && !entry.cachedKnown) ? std::string("???") : PagesOrKilobytes(entry.cached, pageSize, args.pages);
+		}});
+	}
+
+	if (args.commit)
+	{
+		columns.push_back({ "COMMIT", "CHARGE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.commitCharge, pageSize, args.pages);
+		}});
+		columns.push_back({ "LOCKED", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.locked, pageSize, args.pages);
+		}});
+	}
+
+	if (args.pageTables)
+	{
+		columns.push_back({ "PAGE", "TABLES", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.pageTables, pageSize, args.pages);
+		}});
+	}
+
+	if (args.ksm)
+	{
+		columns.push_back({ "KSM", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.ksm, pageSize, args.pages);
+		}});
+	}
+
+	if (args.pss)
+	{
+		columns.push_back({ "PSS", (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.pss, pageSize, args.pages);
+		}});
+		columns.push_back({ "PSS", "DIRTY", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.pssDirty, pageSize, args.pages);
+		}});
+		columns.push_back({ "PSS", "ANON", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.pssAnon, pageSize, args.pages);
+		}});
+		columns.push_back({ "PSS", "FILE", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.pssFile, pageSize, args.pages);
+		}});
+		columns.push_back({ "PSS", "SHMEM", 8, [&args, pageSize](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.pssShmem, pageSize, args.pages);
+		}});
+	}
+
+	if (args.swapDevices)
+	{
+		std::vector<VmmapSwapDevice> devices = ReadSwapDevices();
+		for (std::size_t device = 0; device < devices.size(); ++device)
+		{
+			std::string name = devices[device].ShortName();
+			int width = std::max(8, (int)name.size());
+			columns.push_back({ name, devices[device].kind, width, [&args, pageSize, device](const VmmapSummaryEntry& entry)
+			{
+				return PagesOrKilobytes((device < entry.swapDeviceBytes.size()) ? entry.swapDeviceBytes[device] : 0, pageSize, args.pages);
+			}});
+		}
+	}
+
+	for (std::size_t node = 0; node < nodeCount; ++node)
+	{
+		columns.push_back({ "NODE " + std::to_string(node), (args.pages) ? "PAGES" : "SIZE", 8, [&args, pageSize, node](const VmmapSummaryEntry& entry)
+		{
+			return PagesOrKilobytes(entry.nodeBytes[node], pageSize, args.pages);
+		}});
+	}
+
+	return columns;
+}
+
 static void PrintCore(const std::list<VmmapEntry>& entries, const VmmapArgs& args)
 {
+	const std::vector<CoreColumn> columns = GetCoreColumns(args, entries.empty() ? 0 : entries.front().nodeBytes.size());
+
 	const int REGION_TYPE_WIDTH = 24;
 	const int START_ADDRESS_WIDTH = 12;
 	const int END_ADDRESS_WIDTH = 12;
@@ -362,6 +909,10 @@ static void PrintCore(const std::list<VmmapEntry>& entries, const VmmapArgs& arg
 
 		// Come on, nobody is gonna use a terminal _that_ small.
 		REGION_DETAIL_WIDTH = std::max(0, width - REGION_TYPE_WIDTH - 1 - START_ADDRESS_WIDTH - 1 - END_ADDRESS_WIDTH - 1 - 1 - VSIZE_WIDTH - RSDNT_WIDTH - DIRTY_WIDTH - SWAP_WIDTH - 1 - 1 - PRTMAX_WIDTH - 1 - SHRMOD_WIDTH - 1 - PURGE_WIDTH - 1);
+		for (const auto& column : columns)
+		{
+			REGION_DETAIL_WIDTH = std::max(0, REGION_DETAIL_WIDTH - column.width - 1);
+		}
 	}
 
 	// Header:
@@ -376,72 +927,565 @@ static void PrintCore(const std::list<VmmapEntry>& entries, const VmmapArgs& arg
 				<< "] "
 				<< std::left << std::setw(PRTMAX_WIDTH) << "PRT/MAX" << " "
 				<< std::left << std::setw(SHRMOD_WIDTH) << "SHRMOD" << " "
-				<< std::left << std::setw(PURGE_WIDTH) << "PURGE" << " "
-				<< std::left << "REGION DETAIL"
+				<< std::left << std::setw(PURGE_WIDTH) << "PURGE" << " ";
+	for (const auto& column : columns)
+	{
+		std::cout << std::right << std::setw(column.width) << column.header << " ";
+	}
+	std::cout	<< std::left << "REGION DETAIL"
 				<< std::endl;
 
 	for (const auto& entry : entries)
 	{
+		std::string rsdnt = PagesOrKilobytes(entry.rss, entry.pageSize, args.pages);
+		// Proportional, shared swapped pages would count once per process otherwise.
+		std::string swap = PagesOrKilobytes(entry.swapPss, entry.pageSize, args.pages);
+
+		// Exact counts, rather than smaps byte counts divided by the page size.
+		// They are in base pages, while this row is in pages of the region.
+		if (args.pages && entry.pageStates)
+		{
+			std::size_t basePages = entry.pageSize / PagemapPageSize();
+			rsdnt = std::to_string(entry.pageStates->presentCount / basePages);
+			swap = std::to_string(entry.pageStates->swappedCount / basePages);
+		}
+
 		std::cout 	<< std::left << std::setw(REGION_TYPE_WIDTH) << entry.regionType << " " // The space separated from the string is intended. 
 					<< std::right << std::setw(START_ADDRESS_WIDTH) << std::hex << entry.startAddress << std::dec << "-"
 					<< std::left << std::setw(END_ADDRESS_WIDTH) << std::hex << entry.endAddress << std::dec << " "
 					<< "["
 					<< std::right << std::setw(VSIZE_WIDTH) << PagesOrKilobytes(entry.vsize, entry.pageSize, args.pages) // No spacing between these guys.
-					<< std::right << std::setw(RSDNT_WIDTH) << PagesOrKilobytes(entry.rss, entry.pageSize, args.pages)
+					<< std::right << std::setw(RSDNT_WIDTH) << rsdnt
 					<< std::right << std::setw(DIRTY_WIDTH) << PagesOrKilobytes(entry.dirty, entry.pageSize, args.pages)
-					<< std::right << std::setw(SWAP_WIDTH) << PagesOrKilobytes(entry.swap, entry.pageSize, args.pages)
+					<< std::right << std::setw(SWAP_WIDTH) << swap
 					<< "] "
 					<< std::left << std::setw(PRTMAX_WIDTH) << entry.prt + "/" + entry.max << " "
 					<< std::left << std::setw(SHRMOD_WIDTH) << entry.shrmod << " "
-					<< std::left << std::setw(PURGE_WIDTH) << entry.purge << " "
-					<< std::left << TruncateStringPrefix(entry.regionDetail, REGION_DETAIL_WIDTH)
+					<< std::left << std::setw(PURGE_WIDTH) << entry.purge << " ";
+		for (const auto& column : columns)
+		{
+			std::cout << std::right << std::setw(column.width) << column.value(entry) << " ";
+		}
+		std::cout	<< std::left << TruncateStringPrefix(entry.regionDetail, REGION_DETAIL_WIDTH)
 					<< std::endl;
 	}
 }
 
-static void PrintSummary(const std::list<VmmapEntry>& entries, const VmmapArgs& args)
+static std::unordered_map<std::string, VmmapSummaryEntry> SummarizeRegions(const std::list<VmmapEntry>& entries)
 {
-	std::cout << "==== Summary for process " << args.pid << std::endl;
-	intptr_t readOnlyTotal = 0;
-	intptr_t readOnlyRss = 0;
-
-	intptr_t writeTotal = 0;
-	intptr_t writeRss = 0;
-	intptr_t writeSwap = 0;
+	std::unordered_map<std::string, VmmapSummaryEntry> regions;
 
-	// ReadOnly portion of Libraries: Total=736.8M resident=105.0M(14%) swapped_out_or_unallocated=631.8M(86%)
-	// Writable regions: Total=44.6M written=0K(0%) resident=2100K(5%) swapped_out=0K(0%) unallocated=42.5M(95%)
 	for (const auto & entry : entries)
 	{
-		if (entry.prt[WRITE_INDEX] == 'w')
+		VmmapSummaryEntry& currentRegion = regions[entry.regionType];
+		
+		currentRegion.regionType = entry.regionType;
+		currentRegion.vsize += entry.vsize;
+		currentRegion.rss += entry.rss;
+		currentRegion.dirty += entry.dirty;
+		currentRegion.swap += entry.swapPss;
+		currentRegion.footprint += entry.footprint;
+		
+		// What the kernel can reclaim at no cost, not the size of the region.
+		if (entry.purge == "V")
 		{
-			writeTotal += entry.vsize;
-			writeRss += entry.rss;
-			writeSwap += entry.swap;
+			currentRegion.vol += entry.lazyFree;
 		}
-		// ReadOnly portion of **Libraries** only.
-		else if (entry.regionType == "__TEXT")
+		if (entry.purge == "N")
 		{
-			readOnlyTotal += entry.vsize;
-			readOnlyRss += entry.rss;
+			currentRegion.nonvol += entry.vsize;
 		}
-	}
-
-	// I don't know if this is correct, but apparently this formula yields correct results in many cases.
+		if (entry.purge == "E")
+		{
+			currentRegion.empty += entry.lazyFree;
+		}
+
+		currentRegion.compressible += entry.compressiblePages * PagemapPageSize();
+		currentRegion.compressed += entry.compressedBytes;
+		currentRegion.compressedVariance += entry.compressedVariance;
+
+		currentRegion.accessed += entry.accessedPages * PagemapPageSize();
+		currentRegion.idle += entry.idlePages * PagemapPageSize();
+
+		currentRegion.hot += entry.hotBytes;
+		currentRegion.warm += entry.warmBytes;
+		currentRegion.cold += entry.coldBytes;
+
+		currentRegion.written += entry.writtenPages * PagemapPageSize();
+
+		currentRegion.anonPagesIn += entry.anonPagesIn;
+		currentRegion.swapPagesIn += entry.swapPagesIn;
+		currentRegion.filePagesIn += entry.filePagesIn;
+
+		currentRegion.thp += entry.thpBytes;
+		currentRegion.thpEligible += entry.thpEligibleBytes;
+		currentRegion.hugetlb += entry.hugetlbBytes;
+
+		currentRegion.cached += entry.cachedBytes;
+		if (entry.inode != 0)
+		{
+			currentRegion.cachedKnown = currentRegion.cachedKnown || entry.cacheKnown;
+			currentRegion.cachedUnknown = currentRegion.cachedUnknown || !entry.cacheKnown;
+		}
+
+		currentRegion.commitCharge += entry.CommitCharge();
+		currentRegion.locked += entry.locked;
+
+		currentRegion.ksm += entry.ksmBytes;
+		currentRegion.pageTables += entry.pageTableBytes;
+		currentRegion.pss += entry.pss;
+		currentRegion.pssDirty += entry.pssDirty;
+		currentRegion.pssAnon += entry.pssAnon;
+		currentRegion.pssFile += entry.pssFile;
+		currentRegion.pssShmem += entry.pssShmem;
+
+		currentRegion.swapDeviceBytes.resize(entry.swapDeviceBytes.size());
+		for (std::size_t device = 0; device < entry.swapDeviceBytes.size(); ++device)
+		{
+			currentRegion.swapDeviceBytes[device] += entry.swapDeviceBytes[device];
+		}
+
+		currentRegion.nodeBytes.resize(entry.nodeBytes.size());
+		for (std::size_t node = 0; node < entry.nodeBytes.size(); ++node)
+		{
+			currentRegion.nodeBytes[node] += entry.nodeBytes[node];
+		}
+
+		if (entry.pageStates)
+		{
+			currentRegion.presentPages += entry.pageStates->presentCount;
+			currentRegion.swappedPages += entry.pageStates->swappedCount;
+		}
+
+		++currentRegion.regionCount;
+	}
+
+	return regions;
+}
+
+static void PrintSummary(const std::list<VmmapEntry>& entries, const std::unordered_map<std::string, VmmapSummaryEntry>& regions, const VmmapArgs& args, const VmmapSnapshot& snapshot)
+{
+	std::cout << "==== Summary for process " << args.pid << std::endl;
+	intptr_t readOnlyTotal = 0;
+	intptr_t readOnlyRss = 0;
+
+	intptr_t writeTotal = 0;
+	intptr_t writeRss = 0;
+	intptr_t writeSwap = 0;
+	intptr_t writeDirty = 0;
+	intptr_t writeWritten = 0;
+
+	// ReadOnly portion of Libraries: Total=736.8M resident=105.0M(14%) swapped_out_or_unallocated=631.8M(86%)
+	// Writable regions: Total=44.6M written=0K(0%) resident=2100K(5%) swapped_out=0K(0%) unallocated=42.5M(95%)
+	for (const auto & entry : entries)
+	{
+		if (entry.prt[WRITE_INDEX] == 'w')
+		{
+			writeTotal += entry.vsize;
+			writeRss += entry.rss;
+			writeSwap += entry.swap;
+			writeDirty += entry.dirty;
+			writeWritten += entry.writtenPages * PagemapPageSize();
+		}
+		// ReadOnly portion of **Libraries** only.
+		else if (entry.regionType == "__TEXT")
+		{
+			readOnlyTotal += entry.vsize;
+			readOnlyRss += entry.rss;
+		}
+	}
+
+	// I don't know if this is correct, but apparently this formula yields correct results in many cases.
 	std::cout 	<< "ReadOnly portion of Libraries: "
 				<< "Total=" << FormatData(readOnlyTotal, "") << " " 
 				<< "resident=" << FormatData(readOnlyRss, "") << "(" << Percent(readOnlyRss, readOnlyTotal) << ") "
 				<< "swapped_out_or_unallocated=" << FormatData(readOnlyTotal - readOnlyRss, "") << "(" << Percent(readOnlyTotal - readOnlyRss, readOnlyTotal) << ")"
 				<< std::endl;
 
+	// Without -writes, pages that were ever written are the dirty ones, and
+	// the swapped ones, which were dirty when they were swapped out.
+	intptr_t written = (args.writeSeconds != 0) ? writeWritten : writeDirty + writeSwap;
+
 	std::cout 	<< "Writable regions: "
 				<< "Total=" << FormatData(writeTotal, "") << " " 
-				<< "written=" << FormatData(writeSwap, "") << "(" << Percent(writeSwap, writeTotal) << ") "
+				<< "written=" << FormatData(written, "") << "(" << Percent(written, writeTotal) << ") "
 				<< "resident=" << FormatData(writeRss, "") << "(" << Percent(writeRss, writeTotal) << ") "
 				<< "swapped_out=" << FormatData(writeSwap, "") << "(" << Percent(writeSwap, writeTotal) << ") "
 				<< "unallocated=" << FormatData(writeTotal - writeRss - writeSwap, "") << "(" << Percent(writeTotal - writeRss - writeSwap, writeTotal) << ")"
 				<< std::endl;
 
+	if (args.swapDevices)
+	{
+		std::vector<VmmapSwapDevice> devices = ReadSwapDevices();
+		std::vector<intptr_t> deviceTotals(devices.size());
+		intptr_t swapTotal = 0;
+		intptr_t swapPssTotal = 0;
+
+		for (const auto & entry : entries)
+		{
+			swapTotal += entry.swap;
+			swapPssTotal += entry.swapPss;
+			for (std::size_t device = 0; device < devices.size() && device < entry.swapDeviceBytes.size(); ++device)
+			{
+				deviceTotals[device] += entry.swapDeviceBytes[device];
+			}
+		}
+
+		std::cout	<< "Swap: "
+					<< "swapped=" << FormatData(swapTotal, "") << " "
+					<< "proportional=" << FormatData(swapPssTotal, "");
+		for (std::size_t device = 0; device < devices.size(); ++device)
+		{
+			std::cout << " " << devices[device].ShortName() << "(" << devices[device].kind << ")=" << FormatData(deviceTotals[device], "");
+		}
+		std::cout	<< std::endl;
+	}
+
+	if (args.commit)
+	{
+		VmmapCommitLimits limits = ParseCommitLimits(snapshot);
+		intptr_t charge = 0;
+		intptr_t chargeResident = 0;
+		intptr_t lockedVirtual = 0;
+		intptr_t lockedResident = 0;
+
+		for (const auto & entry : entries)
+		{
+			if (entry.accountable)
+			{
+				charge += entry.vsize;
+				// Swapped pages were resident once, they are not what we look for.
+				chargeResident += std::min(entry.vsize, entry.rss + entry.swap);
+			}
+			if (entry.lockedRegion)
+			{
+				lockedVirtual += entry.vsize;
+			}
+			lockedResident += entry.locked;
+		}
+
+		static const char* const OvercommitModes[] = { "heuristic", "always", "strict" };
+
+		std::cout	<< "Commit charge (overcommit " << ((limits.overcommitMode >= 0 && limits.overcommitMode <= 2) ? OvercommitModes[limits.overcommitMode] : "?") << "): "
+					<< "process=" << FormatData(charge, "") << " "
+					<< "never touched=" << FormatData(charge - chargeResident, "") << "(" << Percent(charge - chargeResident, std::max<intptr_t>(charge, 1)) << ") "
+					<< "Committed_AS=" << FormatData(limits.committed, "") << "(process " << Percent(charge, std::max<intptr_t>(limits.committed, 1)) << ") "
+					<< "CommitLimit=" << FormatData(limits.commitLimit, "") << " "
+					<< "headroom=" << ((limits.committed > limits.commitLimit) ? "-" : "") << FormatData(std::abs((intptr_t)limits.commitLimit - (intptr_t)limits.committed), "")
+					<< std::endl;
+
+		std::cout	<< "Locked memory: "
+					<< "locked_vm=" << FormatData(lockedVirtual, "") << " "
+					<< "resident=" << FormatData(lockedResident, "") << " "
+					<< "RLIMIT_MEMLOCK=" << ((limits.memlockLimit == SIZE_MAX) ? std::string("unlimited") : FormatData(limits.memlockLimit, "") + "(" + Percent(lockedVirtual, std::max<intptr_t>(limits.memlockLimit, 1)) + " used)")
+					<< std::endl;
+	}
+
+	if (args.pageTables)
+	{
+		intptr_t estimated = 0;
+		intptr_t mapped = 0;
+		for (const auto & entry : entries)
+		{
+			estimated += entry.pageTableBytes;
+			mapped += entry.vsize;
+		}
+
+		// What the kernel actually allocated, all levels but the top one.
+		intptr_t reported = -1;
+		std::istringstream status(snapshot.status.Contents());
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, 6, "VmPTE:") == 0)
+			{
+				reported = std::stoll(line.substr(6)) * 1024;
+				break;
+			}
+		}
+
+		std::cout	<< "Page tables: "
+					<< "estimated=" << FormatData(estimated, "") << " "
+					<< "VmPTE=" << ((reported < 0) ? std::string("?") : FormatData(reported, "")) << " "
+					<< "per GB mapped=" << FormatData((intptr_t)((double)estimated * (1 << 30) / std::max<intptr_t>(mapped, 1)), "")
+					<< std::endl;
+	}
+
+	if (args.ksm)
+	{
+		std::map<std::string, std::int64_t> ksmStat;
+		std::istringstream statFile(snapshot.ksmStat.Contents());
+		std::string name;
+		std::string value;
+		while (statFile >> name >> value)
+		{
+			if (isdigit(value[0]) || value[0] == '-')
+			{
+				ksmStat[name] = std::stoll(value);
+			}
+		}
+
+		std::istringstream mergingFile(snapshot.ksmMergingPages.Contents());
+		std::int64_t mergingPages = 0;
+		if (!(mergingFile >> mergingPages))
+		{
+			mergingPages = ksmStat["ksm_merging_pages"];
+		}
+
+		intptr_t mergeable = 0;
+		intptr_t merged = 0;
+		std::size_t mergeableRegions = 0;
+		for (const auto & entry : entries)
+		{
+			if (entry.ksmMergeable)
+			{
+				mergeable += entry.vsize;
+				++mergeableRegions;
+			}
+			merged += entry.ksmBytes;
+		}
+
+		// Kernels without the smaps counter only have the process total.
+		if (merged == 0)
+		{
+			merged = mergingPages * PagemapPageSize();
+		}
+
+		// Writing to a merged page, or a page merged with the zero page, gives
+		// this process a private copy again.
+		intptr_t zeroPages = ksmStat["ksm_zero_pages"] * PagemapPageSize();
+		// Negative when the rmap items cost more than merging saves.
+		intptr_t profit = ksmStat["ksm_process_profit"];
+
+		std::cout	<< "KSM: "
+					<< "mergeable=" << FormatData(mergeable, "") << " in " << mergeableRegions << " regions "
+					<< "merged=" << FormatData(merged, "") << " "
+					<< "zero_pages=" << FormatData(zeroPages, "") << " "
+					<< "profit=" << ((profit < 0) ? "-" : "") << FormatData(std::abs(profit), "") << " "
+					<< "cost of unmerging=" << FormatData(merged + zeroPages, "")
+					<< std::endl;
+	}
+
+	intptr_t lazyVolatile = 0;
+	intptr_t lazyEmpty = 0;
+	intptr_t residentTotal = 0;
+	for (const auto & entry : entries)
+	{
+		residentTotal += entry.rss;
+		(entry.purge == "E" ? lazyEmpty : lazyVolatile) += entry.lazyFree;
+	}
+
+	if (lazyVolatile + lazyEmpty != 0)
+	{
+		std::cout	<< "Purgeable (MADV_FREE): "
+					<< "volatile=" << FormatData(lazyVolatile, "") << " "
+					<< "empty=" << FormatData(lazyEmpty, "") << " "
+					<< "reclaimable at no cost=" << FormatData(lazyVolatile + lazyEmpty, "") << "(" << Percent(lazyVolatile + lazyEmpty, std::max<intptr_t>(residentTotal, 1)) << " of resident)"
+					<< std::endl;
+	}
+
+	if (args.faultSeconds != 0)
+	{
+		std::size_t anon = 0;
+		std::size_t swap = 0;
+		std::size_t file = 0;
+		for (const auto & entry : entries)
+		{
+			anon += entry.anonPagesIn;
+			swap += entry.swapPagesIn;
+			file += entry.filePagesIn;
+		}
+
+		// Pages and faults do not compare: one fault can map a whole THP, or
+		// fault_around_bytes of a file, so the kernel counters are printed
+		// next to the pages, not as their total.
+		std::size_t pagesIn = anon + swap + file;
+
+		std::cout	<< "Pages faulted in (" << args.faultSeconds << "s, sampled every " << args.faultInterval << "ms): "
+					<< pagesIn << " (" << Rate(pagesIn, args.faultSeconds) << "/s): "
+					<< "first touch=" << anon << " "
+					<< "swap-in=" << swap << " "
+					<< "file=" << file << "; "
+					<< "process faults: "
+					<< "min_flt=" << snapshot.minorFaults << " "
+					<< "maj_flt=" << snapshot.majorFaults << " "
+					<< "rate=" << Rate(snapshot.minorFaults + snapshot.majorFaults, args.faultSeconds) << "/s"
+					<< std::endl;
+	}
+
+	if (args.pss)
+	{
+		std::uint64_t pss = 0;
+		std::uint64_t pssAnon = 0;
+		std::uint64_t pssFile = 0;
+		std::uint64_t pssShmem = 0;
+		for (const auto & entry : entries)
+		{
+			pss += entry.pss;
+			pssAnon += entry.pssAnon;
+			pssFile += entry.pssFile;
+			pssShmem += entry.pssShmem;
+		}
+
+		// smaps_rollup adds up the unrounded values of all regions, so it is
+		// more precise than the sum of the per region values, which lose up to
+		// 1K each.
+		std::uint64_t rollup = 0;
+		std::stringstream ss(snapshot.smapsRollup.Contents());
+		std::string line;
+		while (std::getline(ss, line))
+		{
+			if (line.compare(0, 4, "Pss:") == 0)
+			{
+				rollup = std::stoull(line.substr(4)) * 1024;
+				break;
+			}
+		}
+
+		std::cout	<< "Proportional set size: "
+					<< "PSS=" << FormatData((intptr_t)pss, "") << " "
+					<< "anon=" << FormatData((intptr_t)pssAnon, "") << " "
+					<< "file=" << FormatData((intptr_t)pssFile, "") << " "
+					<< "shmem=" << FormatData((intptr_t)pssShmem, "") << " "
+					<< "smaps_rollup=" << (snapshot.smapsRollup.present ? FormatData((intptr_t)rollup, "") : std::string("?")) << " "
+					<< "rounding=" << (snapshot.smapsRollup.present ? std::to_string((std::int64_t)(rollup - pss) / 1024) + "K" : std::string("?"))
+					<< std::endl;
+	}
+
+	if (args.preciseSharing)
+	{
+		// Pages of private writable regions that are still mapped elsewhere were
+		// not written to since fork(), and are still shared with the parent or siblings.
+		intptr_t sharedTotal = 0;
+		intptr_t residentTotal = 0;
+		intptr_t cowShared = 0;
+		intptr_t cowResident = 0;
+
+		for (const auto & entry : entries)
+		{
+			intptr_t shared = entry.sharedPages * PagemapPageSize();
+			intptr_t resident = (entry.sharedPages + entry.privatePages) * PagemapPageSize();
+
+			sharedTotal += shared;
+			residentTotal += resident;
+
+			if (!entry.sharedMapping && entry.prt[WRITE_INDEX] == 'w')
+			{
+				cowShared += shared;
+				cowResident += resident;
+			}
+		}
+
+		std::cout	<< "Sharing (from kpagecount): "
+					<< "resident=" << FormatData(residentTotal, "") << " "
+					<< "shared=" << FormatData(sharedTotal, "") << "(" << Percent(sharedTotal, std::max<intptr_t>(residentTotal, 1)) << ") "
+					<< "private writable still shared=" << FormatData(cowShared, "") << "(" << Percent(cowShared, std::max<intptr_t>(cowResident, 1)) << ")"
+					<< std::endl;
+	}
+
+	if (args.compressibility)
+	{
+		double compressible = 0;
+		double compressed = 0;
+		double variance = 0;
+		std::size_t samples = 0;
+
+		for (const auto & entry : entries)
+		{
+			compressible += (double)entry.compressiblePages * PagemapPageSize();
+			compressed += entry.compressedBytes;
+			variance += entry.compressedVariance;
+			samples += entry.compressionSamples;
+		}
+
+		// Regions are sampled independently, so their variances add up.
+		double margin = 1.96 * std::sqrt(variance);
+
+		std::cout	<< "Compressibility of private anonymous memory: "
+					<< "exclusive=" << FormatData((std::intptr_t)compressible, "") << " "
+					<< "compressed=" << FormatData((std::intptr_t)compressed, "")
+					<< "(95% CI " << FormatData((std::intptr_t)std::max(0.0, compressed - margin), "") << "-" << FormatData((std::intptr_t)(compressed + margin), "") << ") "
+					<< "ratio=" << Ratio(compressible, compressed) << " "
+					<< "sampled=" << samples << " pages"
+					<< std::endl;
+	}
+
+	if (args.workingSetSeconds != 0)
+	{
+		intptr_t accessedTotal = 0;
+		intptr_t idleTotal = 0;
+
+		for (const auto & entry : entries)
+		{
+			accessedTotal += entry.accessedPages * PagemapPageSize();
+			idleTotal += entry.idlePages * PagemapPageSize();
+		}
+
+		std::cout	<< "Working set (accessed in " << args.workingSetSeconds << "s): "
+					<< "resident=" << FormatData(accessedTotal + idleTotal, "") << " "
+					<< "accessed=" << FormatData(accessedTotal, "") << "(" << Percent(accessedTotal, std::max<intptr_t>(accessedTotal + idleTotal, 1)) << ") "
+					<< "idle=" << FormatData(idleTotal, "") << "(" << Percent(idleTotal, std::max<intptr_t>(accessedTotal + idleTotal, 1)) << ")"
+					<< std::endl;
+	}
+
+	if (args.damonSeconds != 0)
+	{
+		intptr_t hotTotal = 0;
+		intptr_t warmTotal = 0;
+		intptr_t coldTotal = 0;
+
+		for (const auto & entry : entries)
+		{
+			hotTotal += entry.hotBytes;
+			warmTotal += entry.warmBytes;
+			coldTotal += entry.coldBytes;
+		}
+
+		intptr_t monitored = std::max<intptr_t>(hotTotal + warmTotal + coldTotal, 1);
+
+		std::cout	<< "Access heat (DAMON, " << args.damonSeconds << "s): "
+					<< "hot=" << FormatData(hotTotal, "") << "(" << Percent(hotTotal, monitored) << ") "
+					<< "warm=" << FormatData(warmTotal, "") << "(" << Percent(warmTotal, monitored) << ") "
+					<< "cold=" << FormatData(coldTotal, "") << "(" << Percent(coldTotal, monitored) << ")"
+					<< std::endl;
+	}
+
+	if (args.hugePages)
+	{
+		// The heap is all private anonymous writable memory but stacks: malloc
+		// zones, the brk heap, and anonymous mmap()s.
+		VmmapThpSettings settings = ReadThpSettings(snapshot);
+		intptr_t heapTotal = 0;
+		intptr_t heapThp = 0;
+		intptr_t heapEligible = 0;
+		std::map<std::size_t, intptr_t> hugetlbBySize;
+
+		for (const auto & entry : entries)
+		{
+			if (entry.hugetlb)
+			{
+				hugetlbBySize[entry.pageSize] += entry.hugetlbBytes;
+			}
+			else if (entry.inode == 0 && !entry.sharedMapping && entry.prt[WRITE_INDEX] == 'w' && entry.regionType != "Stack")
+			{
+				heapTotal += entry.vsize;
+				heapThp += entry.thpBytes;
+				heapEligible += entry.thpEligibleBytes;
+			}
+		}
+
+		std::cout	<< "Huge pages (THP " << (settings.enabled.empty() ? "unavailable" : settings.enabled)
+					<< (settings.processEnabled ? "" : ", disabled by the process") << "): "
+					<< "heap=" << FormatData(heapTotal, "") << " "
+					<< "eligible=" << FormatData(heapEligible, "") << "(" << Percent(heapEligible, std::max<intptr_t>(heapTotal, 1)) << ") "
+					<< "THP-backed=" << FormatData(heapThp, "") << "(" << Percent(heapThp, std::max<intptr_t>(heapEligible, 1)) << " of eligible)";
+		for (const auto& size : hugetlbBySize)
+		{
+			std::cout << " hugetlb[" << FormatData(size.first, "") << "]=" << FormatData(size.second, "");
+		}
+		std::cout	<< std::endl;
+	}
+
 	std::cout << std::endl;
 
 	std::string PagesOrSize = (args.pages) ? "PAGES" : "SIZE";
@@ -455,6 +1499,10 @@ static void PrintSummary(const std::list<VmmapEntry>& entries, const VmmapArgs&
 	const int EMPTY_WIDTH = 8;
 	const int REGION_COUNT_WIDTH = 7;
 
+	// Regions of one type can have different page sizes (hugetlb), so the
+	// summary counts in base pages.
+	const std::vector<SummaryColumn> columns = GetSummaryColumns(args, PagemapPageSize(), entries.front().nodeBytes.size());
+
 	// First line.
 	std::cout   << std::left << std::setw(REGION_TYPE_WIDTH) << "" << " "
 				<< std::right << std::setw(VIRTUAL_WIDTH) << "VIRTUAL" << " "
@@ -463,8 +1511,12 @@ static void PrintSummary(const std::list<VmmapEntry>& entries, const VmmapArgs&
 				<< std::right << std::setw(SWAPPED_WIDTH) << "SWAPPED" << " "
 				<< std::right << std::setw(VOLATILE_WIDTH) << "VOLATILE" << " "
 				<< std::right << std::setw(NONVOL_WIDTH) << "NONVOL" << " "
-				<< std::right << std::setw(EMPTY_WIDTH) << "EMPTY" << " "
-				<< std::right << std::setw(REGION_COUNT_WIDTH) << "REGION"
+				<< std::right << std::setw(EMPTY_WIDTH) << "EMPTY" << " ";
+	for (const auto& column : columns)
+	{
+		std::cout << std::right << std::setw(column.width) << column.header << " ";
+	}
+	std::cout	<< std::right << std::setw(REGION_COUNT_WIDTH) << "REGION"
 				<< std::endl;
 
 	// Second line.
@@ -475,8 +1527,12 @@ static void PrintSummary(const std::list<VmmapEntry>& entries, const VmmapArgs&
 				<< std::right << std::setw(SWAPPED_WIDTH) << PagesOrSize << " "
 				<< std::right << std::setw(VOLATILE_WIDTH) << PagesOrSize << " "
 				<< std::right << std::setw(NONVOL_WIDTH) << PagesOrSize << " "
-				<< std::right << std::setw(EMPTY_WIDTH) << PagesOrSize << " "
-				<< std::right << std::setw(REGION_COUNT_WIDTH) << "COUNT" << " "
+				<< std::right << std::setw(EMPTY_WIDTH) << PagesOrSize << " ";
+	for (const auto& column : columns)
+	{
+		std::cout << std::right << std::setw(column.width) << column.subheader << " ";
+	}
+	std::cout	<< std::right << std::setw(REGION_COUNT_WIDTH) << "COUNT" << " "
 				<< "(non-coalesced)"
 				<< std::endl;
 
@@ -488,52 +1544,33 @@ static void PrintSummary(const std::list<VmmapEntry>& entries, const VmmapArgs&
 				<< std::right << std::setw(SWAPPED_WIDTH) << "=======" << " "
 				<< std::right << std::setw(VOLATILE_WIDTH) << "========" << " "
 				<< std::right << std::setw(NONVOL_WIDTH) << "======" << " "
-				<< std::right << std::setw(EMPTY_WIDTH) << "=====" << " "
-				<< std::right << std::setw(REGION_COUNT_WIDTH) << "======="
-				<< std::endl;
-
-	std::unordered_map<std::string, VmmapSummaryEntry> regions;
-
-	for (const auto & entry : entries)
+				<< std::right << std::setw(EMPTY_WIDTH) << "=====" << " ";
+	for (const auto& column : columns)
 	{
-		VmmapSummaryEntry& currentRegion = regions[entry.regionType];
-		
-		currentRegion.regionType = entry.regionType;
-		currentRegion.vsize += entry.vsize;
-		currentRegion.rss += entry.rss;
-		currentRegion.dirty += entry.dirty;
-		currentRegion.swap += entry.swap;
-		
-		if (entry.purge == "V")
-		{
-			currentRegion.vol += entry.vsize;
-		}
-		if (entry.purge == "N")
-		{
-			currentRegion.nonvol += entry.vsize;
-		}
-		if (entry.purge == "E")
-		{
-			currentRegion.empty += entry.vsize;
-		}
-
-		++currentRegion.regionCount;
+		std::cout << std::right << std::setw(column.width) << std::string(std::max(column.header.size(), column.subheader.size()), '=') << " ";
 	}
+	std::cout	<< std::right << std::setw(REGION_COUNT_WIDTH) << "======="
+				<< std::endl;
 
-	std::size_t pageSize = entries.front().pageSize;
+	std::size_t pageSize = PagemapPageSize();
+	bool exactPages = args.pages && entries.front().pageStates;
 
 	for (const auto & kvp : regions)
 	{
 		const VmmapSummaryEntry& entry = kvp.second;
 		std::cout	<< std::left << std::setw(REGION_TYPE_WIDTH) << TruncateStringSuffix(entry.regionType, REGION_TYPE_WIDTH) << " "
 					<< std::right << std::setw(VIRTUAL_WIDTH) << PagesOrKilobytes(entry.vsize, pageSize, args.pages) << " "
-					<< std::right << std::setw(RESIDENT_WIDTH) << PagesOrKilobytes(entry.rss, pageSize, args.pages) << " "
+					<< std::right << std::setw(RESIDENT_WIDTH) << (exactPages ? std::to_string(entry.presentPages) : PagesOrKilobytes(entry.rss, pageSize, args.pages)) << " "
 					<< std::right << std::setw(DIRTY_WIDTH) << PagesOrKilobytes(entry.dirty, pageSize, args.pages) << " "
-					<< std::right << std::setw(SWAPPED_WIDTH) << PagesOrKilobytes(entry.swap, pageSize, args.pages) << " "
+					<< std::right << std::setw(SWAPPED_WIDTH) << (exactPages ? std::to_string(entry.swappedPages) : PagesOrKilobytes(entry.swap, pageSize, args.pages)) << " "
 					<< std::right << std::setw(VOLATILE_WIDTH) << PagesOrKilobytes(entry.vol, pageSize, args.pages) << " "
 					<< std::right << std::setw(NONVOL_WIDTH) << PagesOrKilobytes(entry.nonvol, pageSize, args.pages) << " "
-					<< std::right << std::setw(EMPTY_WIDTH) << PagesOrKilobytes(entry.empty, pageSize, args.pages) << " "
-					<< std::right << std::setw(REGION_COUNT_WIDTH) << entry.regionCount << " ";
+					<< std::right << std::setw(EMPTY_WIDTH) << PagesOrKilobytes(entry.empty, pageSize, args.pages) << " ";
+		for (const auto& column : columns)
+		{
+			std::cout << std::right << std::setw(column.width) << column.value(entry) << " ";
+		}
+		std::cout	<< std::right << std::setw(REGION_COUNT_WIDTH) << entry.regionCount << " ";
 
 		if (entry.IsMalloc())
 		{
@@ -602,20 +1639,28 @@ static void PrintMalloc(const std::list<VmmapEntry>& entries, const VmmapArgs& a
 				<< std::right << std::setw(REGION_COUNT_WIDTH) << "======"
 				<< std::endl;
 
-	// Here, we might have to access the relevant APIs and fetch additional data. Let's ignore for now.
-
 	std::unordered_map<std::string, VmmapSummaryEntry> mallocZones;
+	// In the order of their lowest region.
+	std::vector<std::string> zoneOrder;
 
 	for (const auto& entry : entries)
 	{
 		if (entry.IsMalloc())
 		{
+			if (mallocZones.count(entry.regionDetail) == 0)
+			{
+				zoneOrder.push_back(entry.regionDetail);
+			}
 			VmmapSummaryEntry& summaryEntry = mallocZones[entry.regionDetail];
 			summaryEntry.regionType = entry.regionDetail;
 			summaryEntry.vsize += entry.vsize;
 			summaryEntry.rss += entry.rss;
 			summaryEntry.dirty += entry.dirty;
-			summaryEntry.swap += entry.swap;
+			summaryEntry.swap += entry.swapPss;
+			summaryEntry.mallocWalked = summaryEntry.mallocWalked || entry.mallocWalked;
+			summaryEntry.mallocCount += entry.mallocCount;
+			summaryEntry.mallocBytes += entry.mallocBytes;
+			summaryEntry.mallocHeaderBytes += entry.mallocHeaderBytes;
 			
 			++summaryEntry.regionCount;
 		}
@@ -623,21 +1668,661 @@ static void PrintMalloc(const std::list<VmmapEntry>& entries, const VmmapArgs& a
 
 	std::size_t pageSize = entries.front().pageSize;
 
-	for (const auto & kvp : mallocZones)
+	for (const auto & name : zoneOrder)
 	{
-		const VmmapSummaryEntry& zone = kvp.second;
+		const VmmapSummaryEntry& zone = mallocZones.at(name);
+		// What is dirty or swapped, but not allocated or arena headers: free
+		// chunks that were used before.
+		intptr_t used = zone.dirty + zone.swap;
+		intptr_t fragmentation = std::max<intptr_t>(used - (intptr_t)zone.mallocBytes - (intptr_t)zone.mallocHeaderBytes, 0);
+
 		std::cout   << std::left << std::setw(REGION_TYPE_WIDTH) << TruncateStringSuffix(zone.regionType, REGION_TYPE_WIDTH) << " "
 					<< std::right << std::setw(VIRTUAL_WIDTH) << PagesOrKilobytes(zone.vsize, pageSize, args.pages) << " "
 					<< std::right << std::setw(RESIDENT_WIDTH) << PagesOrKilobytes(zone.rss, pageSize, args.pages) << " "
 					<< std::right << std::setw(DIRTY_WIDTH) << PagesOrKilobytes(zone.dirty, pageSize, args.pages) << " "
 					<< std::right << std::setw(SWAPPED_WIDTH) << PagesOrKilobytes(zone.swap, pageSize, args.pages) << " "
-					<< std::right << std::setw(ALLOCATION_COUNT_WIDTH) << "???" << " "
-					<< std::right << std::setw(BYTES_ALLOCATED_WIDTH) << "???" << " "
-					<< std::right << std::setw(DIRTY_SWAP_FRAG_SIZE_WIDTH) << "???" << " "
-					<< std::right << std::setw(FRAG_WIDTH) << "??%" << " "
+					<< std::right << std::setw(ALLOCATION_COUNT_WIDTH) << (zone.mallocWalked ? std::to_string(zone.mallocCount) : std::string("???")) << " "
+					<< std::right << std::setw(BYTES_ALLOCATED_WIDTH) << (zone.mallocWalked ? PagesOrKilobytes(zone.mallocBytes, pageSize, args.pages) : std::string("???")) << " "
+					<< std::right << std::setw(DIRTY_SWAP_FRAG_SIZE_WIDTH) << (zone.mallocWalked ? PagesOrKilobytes(fragmentation, pageSize, args.pages) : std::string("???")) << " "
+					<< std::right << std::setw(FRAG_WIDTH) << (zone.mallocWalked ? Percent(fragmentation, std::max<intptr_t>(used, 1)) : std::string("??%")) << " "
 					<< std::right << std::setw(REGION_COUNT_WIDTH) << zone.regionCount << " "
 					<< std::endl;
 	}
 
+	std::cout << std::endl;
+}
+
+static void PrintPageStates(const std::list<VmmapEntry>& entries, const VmmapArgs& args)
+{
+	const int REGION_TYPE_WIDTH = 30;
+	const int PAGES_WIDTH = 10;
+	const int PRESENT_WIDTH = 10;
+	const int SWAPPED_WIDTH = 10;
+	const int EXCLUSIVE_WIDTH = 10;
+	const int SOFT_DIRTY_WIDTH = 10;
+	const int FILE_WIDTH = 10;
+	const int UNTOUCHED_WIDTH = 10;
+
+	std::cout << "==== Page states for process " << args.pid << " (from pagemap, " << PagemapPageSize() << " byte pages)" << std::endl;
+
+	std::cout   << std::left << std::setw(REGION_TYPE_WIDTH) << "REGION TYPE" << " "
+				<< std::right << std::setw(PAGES_WIDTH) << "PAGES" << " "
+				<< std::right << std::setw(PRESENT_WIDTH) << "PRESENT" << " "
+				<< std::right << std::setw(SWAPPED_WIDTH) << "SWAPPED" << " "
+				<< std::right << std::setw(EXCLUSIVE_WIDTH) << "EXCLUSIVE" << " "
+				<< std::right << std::setw(SOFT_DIRTY_WIDTH) << "SOFT-DIRTY" << " "
+				<< std::right << std::setw(FILE_WIDTH) << "FILE/SHM" << " "
+				<< std::right << std::setw(UNTOUCHED_WIDTH) << "UNTOUCHED"
+				<< std::endl;
+
+	std::cout   << std::left << std::setw(REGION_TYPE_WIDTH) << "===========" << " "
+				<< std::right << std::setw(PAGES_WIDTH) << "=====" << " "
+				<< std::right << std::setw(PRESENT_WIDTH) << "=======" << " "
+				<< std::right << std::setw(SWAPPED_WIDTH) << "=======" << " "
+				<< std::right << std::setw(EXCLUSIVE_WIDTH) << "=========" << " "
+				<< std::right << std::setw(SOFT_DIRTY_WIDTH) << "==========" << " "
+				<< std::right << std::setw(FILE_WIDTH) << "========" << " "
+				<< std::right << std::setw(UNTOUCHED_WIDTH) << "========="
+				<< std::endl;
+
+	std::unordered_map<std::string, VmmapSummaryEntry> regions;
+
+	for (const auto& entry : entries)
+	{
+		if (!entry.pageStates)
+		{
+			continue;
+		}
+
+		VmmapSummaryEntry& region = regions[entry.regionType];
+		region.regionType = entry.regionType;
+		region.pages += entry.pageStates->pages;
+		region.presentPages += entry.pageStates->presentCount;
+		region.swappedPages += entry.pageStates->swappedCount;
+		region.exclusivePages += entry.pageStates->exclusiveCount;
+		region.softDirtyPages += entry.pageStates->softDirtyCount;
+		region.filePages += entry.pageStates->fileCount;
+	}
+
+	for (const auto& kvp : regions)
+	{
+		const VmmapSummaryEntry& region = kvp.second;
+		std::cout   << std::left << std::setw(REGION_TYPE_WIDTH) << TruncateStringSuffix(region.regionType, REGION_TYPE_WIDTH) << " "
+					<< std::right << std::setw(PAGES_WIDTH) << region.pages << " "
+					<< std::right << std::setw(PRESENT_WIDTH) << region.presentPages << " "
+					<< std::right << std::setw(SWAPPED_WIDTH) << region.swappedPages << " "
+					<< std::right << std::setw(EXCLUSIVE_WIDTH) << region.exclusivePages << " "
+					<< std::right << std::setw(SOFT_DIRTY_WIDTH) << region.softDirtyPages << " "
+					<< std::right << std::setw(FILE_WIDTH) << region.filePages << " "
+					<< std::right << std::setw(UNTOUCHED_WIDTH) << region.pages - region.presentPages - region.swappedPages
+					<< std::endl;
+	}
+
+	std::cout << std::endl;
+}
+
+void PrintFamily(const VmmapFamily& family, const VmmapArgs& args)
+{
+	const std::size_t pageSize = PagemapPageSize();
+	const char* const bucketNames[FamilyHistogramBuckets] = { "1", "2", "3-4", "5-8", "9-16", "17-32", "33-64", "65+" };
+
+	std::cout << "==== Sharing between " << family.processes.size() << " processes:";
+	for (const auto& process : family.processes)
+	{
+		std::cout << " " << process.pid;
+	}
+	std::cout << std::endl;
+
+	std::cout	<< "Total: "
+				<< "summed resident=" << FormatData(family.rss * pageSize, "") << " "
+				<< "deduplicated=" << FormatData(family.unique * pageSize, "") << "(" << Percent(family.unique, std::max<std::size_t>(family.rss, 1)) << ")"
+				<< std::endl;
+	std::cout << std::endl;
+
+	std::string PagesOrSize = (args.pages) ? "PAGES" : "SIZE";
+	const int PROCESS_WIDTH = 30;
+	const int RESIDENT_WIDTH = 8;
+	const int PSS_WIDTH = 8;
+	const int USS_WIDTH = 8;
+
+	std::cout   << std::left << std::setw(PROCESS_WIDTH) << "PROCESS" << " "
+				<< std::right << std::setw(RESIDENT_WIDTH) << "RESIDENT" << " "
+				<< std::right << std::setw(PSS_WIDTH) << "PSS" << " "
+				<< std::right << std::setw(USS_WIDTH) << "USS"
+				<< std::endl;
+
+	std::cout   << std::left << std::setw(PROCESS_WIDTH) << "=======" << " "
+				<< std::right << std::setw(RESIDENT_WIDTH) << "========" << " "
+				<< std::right << std::setw(PSS_WIDTH) << "===" << " "
+				<< std::right << std::setw(USS_WIDTH) << "==="
+				<< std::endl;
+
+	for (const auto& process : family.processes)
+	{
+		std::cout   << std::left << std::setw(PROCESS_WIDTH) << process.pid << " "
+					<< std::right << std::setw(RESIDENT_WIDTH) << PagesOrKilobytes(process.rss * pageSize, pageSize, args.pages) << " "
+					<< std::right << std::setw(PSS_WIDTH) << PagesOrKilobytes((std::size_t)std::llround(process.pss * pageSize), pageSize, args.pages) << " "
+					<< std::right << std::setw(USS_WIDTH) << PagesOrKilobytes(process.uss * pageSize, pageSize, args.pages)
+					<< std::endl;
+	}
+
+	std::cout << std::endl;
+
+	// Same layout as the summary table, with the deduplicated columns and
+	// a histogram of how many processes map each page.
+	const int REGION_TYPE_WIDTH = 30;
+	const int UNIQUE_WIDTH = 8;
+	const int BUCKET_WIDTH = 7;
+
+	std::cout   << std::left << std::setw(REGION_TYPE_WIDTH) << "" << " "
+				<< std::right << std::setw(RESIDENT_WIDTH) << "SUMMED" << " "
+				<< std::right << std::setw(UNIQUE_WIDTH) << "DEDUPED" << " "
+				<< std::right << std::setw(USS_WIDTH) << "" << " "
+				<< "SHARED WITH N PROCESSES"
+				<< std::endl;
+
+	std::cout   << std::left << std::setw(REGION_TYPE_WIDTH) << "REGION TYPE" << " "
+				<< std::right << std::setw(RESIDENT_WIDTH) << "RESIDENT" << " "
+				<< std::right << std::setw(UNIQUE_WIDTH) << "(PSS)" << " "
+				<< std::right << std::setw(USS_WIDTH) << "USS";
+	for (int bucket = 0; bucket < FamilyHistogramBuckets; ++bucket)
+	{
+		std::cout << " " << std::right << std::setw(BUCKET_WIDTH) << bucketNames[bucket];
+	}
+	std::cout << std::endl;
+
+	std::cout   << std::left << std::setw(REGION_TYPE_WIDTH) << "===========" << " "
+				<< std::right << std::setw(RESIDENT_WIDTH) << "========" << " "
+				<< std::right << std::setw(UNIQUE_WIDTH) << "=======" << " "
+				<< std::right << std::setw(USS_WIDTH) << "===";
+	for (int bucket = 0; bucket < FamilyHistogramBuckets; ++bucket)
+	{
+		std::cout << " " << std::right << std::setw(BUCKET_WIDTH) << "=====";
+	}
+	std::cout << std::endl;
+
+	for (const auto& region : family.regions)
+	{
+		if (region.rss == 0)
+		{
+			continue;
+		}
+
+		std::cout   << std::left << std::setw(REGION_TYPE_WIDTH) << TruncateStringSuffix(region.regionType, REGION_TYPE_WIDTH) << " "
+					<< std::right << std::setw(RESIDENT_WIDTH) << PagesOrKilobytes(region.rss * pageSize, pageSize, args.pages) << " "
+					<< std::right << std::setw(UNIQUE_WIDTH) << PagesOrKilobytes(region.unique * pageSize, pageSize, args.pages) << " "
+					<< std::right << std::setw(USS_WIDTH) << PagesOrKilobytes(region.uss * pageSize, pageSize, args.pages);
+		for (int bucket = 0; bucket < FamilyHistogramBuckets; ++bucket)
+		{
+			std::cout << " " << std::right << std::setw(BUCKET_WIDTH) << PagesOrKilobytes(region.histogram[bucket] * pageSize, pageSize, args.pages);
+		}
+		std::cout << std::endl;
+	}
+
+	std::cout << std::endl;
+}
+
+static void PrintZeroPages(const std::list<VmmapEntry>& entries, const VmmapArgs& args)
+{
+	const std::size_t pageSize = PagemapPageSize();
+	const int REGION_TYPE_WIDTH = 24;
+	const int START_ADDRESS_WIDTH = 12;
+	const int END_ADDRESS_WIDTH = 12;
+	const int SCANNED_WIDTH = 9;
+	const int ZERO_WIDTH = 9;
+	const int PERCENT_WIDTH = 6;
+
+	std::cout << "==== Zero pages for process " << args.pid << " (resident, writable and private, could be dropped with madvise)" << std::endl;
+
+	std::cout 	<< std::left << std::setw(REGION_TYPE_WIDTH) << "REGION TYPE" << " "
+				<< std::right << std::setw(START_ADDRESS_WIDTH) << "START " << "-"
+				<< std::left << std::setw(END_ADDRESS_WIDTH) << " END" << " "
+				<< std::right << std::setw(SCANNED_WIDTH) << "SCANNED" << " "
+				<< std::right << std::setw(ZERO_WIDTH) << "ZERO" << " "
+				<< std::right << std::setw(PERCENT_WIDTH) << "%" << " "
+				<< std::left << "REGION DETAIL"
+				<< std::endl;
+
+	std::size_t scannedTotal = 0;
+	std::size_t zeroTotal = 0;
+	// Scanned and zero pages, per zone.
+	std::unordered_map<std::string, std::pair<std::size_t, std::size_t>> mallocZones;
+
+	for (const auto& entry : entries)
+	{
+		scannedTotal += entry.scannedPages;
+		zeroTotal += entry.zeroPages;
+
+		if (entry.IsMalloc())
+		{
+			mallocZones[entry.regionDetail].first += entry.scannedPages;
+			mallocZones[entry.regionDetail].second += entry.zeroPages;
+		}
+
+		if (entry.zeroPages == 0)
+		{
+			continue;
+		}
+
+		std::cout 	<< std::left << std::setw(REGION_TYPE_WIDTH) << entry.regionType << " "
+					<< std::right << std::setw(START_ADDRESS_WIDTH) << std::hex << entry.startAddress << std::dec << "-"
+					<< std::left << std::setw(END_ADDRESS_WIDTH) << std::hex << entry.endAddress << std::dec << " "
+					<< std::right << std::setw(SCANNED_WIDTH) << PagesOrKilobytes(entry.scannedPages * pageSize, pageSize, args.pages) << " "
+					<< std::right << std::setw(ZERO_WIDTH) << PagesOrKilobytes(entry.zeroPages * pageSize, pageSize, args.pages) << " "
+					<< std::right << std::setw(PERCENT_WIDTH) << Percent(entry.zeroPages, entry.scannedPages) << " "
+					<< std::left << entry.regionDetail
+					<< std::endl;
+	}
+
+	std::cout	<< "Total: scanned=" << FormatData(scannedTotal * pageSize, "") << " "
+				<< "zero=" << FormatData(zeroTotal * pageSize, "") << "(" << Percent(zeroTotal, std::max<std::size_t>(scannedTotal, 1)) << ")"
+				<< std::endl;
+
+	for (const auto& kvp : mallocZones)
+	{
+		std::size_t scanned = kvp.second.first;
+		std::size_t zero = kvp.second.second;
+		std::cout	<< "MALLOC zone " << kvp.first << ": "
+					<< "scanned=" << FormatData(scanned * pageSize, "") << " "
+					<< "zero=" << FormatData(zero * pageSize, "") << "(" << Percent(zero, std::max<std::size_t>(scanned, 1)) << ")"
+					<< std::endl;
+	}
+
+	std::cout << std::endl;
+}
+
+void PrintDuplicates(const VmmapDuplicates& duplicates, const VmmapArgs& args)
+{
+	const std::size_t pageSize = PagemapPageSize();
+	const int NAME_WIDTH = 30;
+	const int SCANNED_WIDTH = 9;
+	const int DUPLICATE_WIDTH = 9;
+	const int PERCENT_WIDTH = 6;
+
+	std::cout << "==== Duplicate pages (resident anonymous pages identical to another one";
+	if (duplicates.twoPass)
+	{
+		std::cout << ", read in two passes";
+	}
+	std::cout << ")" << std::endl;
+
+	std::cout	<< "Total: scanned=" << FormatData(duplicates.scanned * pageSize, "") << " "
+				<< "reclaimable by merging=" << FormatData((std::intptr_t)(duplicates.duplicate * pageSize), "")
+				<< "(" << Percent(duplicates.duplicate, std::max<double>(duplicates.scanned, 1)) << ")"
+				<< std::endl;
+	std::cout << std::endl;
+
+	auto printTable = [&](const std::string& title, const std::vector<VmmapDuplicateRow>& rows)
+	{
+		std::cout   << std::left << std::setw(NAME_WIDTH) << title << " "
+					<< std::right << std::setw(SCANNED_WIDTH) << "SCANNED" << " "
+					<< std::right << std::setw(DUPLICATE_WIDTH) << "DUPLICATE" << " "
+					<< std::right << std::setw(PERCENT_WIDTH) << "%"
+					<< std::endl;
+
+		std::cout   << std::left << std::setw(NAME_WIDTH) << std::string(title.size(), '=') << " "
+					<< std::right << std::setw(SCANNED_WIDTH) << "=======" << " "
+					<< std::right << std::setw(DUPLICATE_WIDTH) << "=========" << " "
+					<< std::right << std::setw(PERCENT_WIDTH) << "="
+					<< std::endl;
+
+		for (const auto& row : rows)
+		{
+			if (row.scanned == 0)
+			{
+				continue;
+			}
+
+			std::cout   << std::left << std::setw(NAME_WIDTH) << TruncateStringSuffix(row.name, NAME_WIDTH) << " "
+						<< std::right << std::setw(SCANNED_WIDTH) << PagesOrKilobytes(row.scanned * pageSize, pageSize, args.pages) << " "
+						<< std::right << std::setw(DUPLICATE_WIDTH) << PagesOrKilobytes((std::size_t)std::llround(row.duplicate * pageSize), pageSize, args.pages) << " "
+						<< std::right << std::setw(PERCENT_WIDTH) << Percent(row.duplicate, (double)row.scanned)
+						<< std::endl;
+		}
+
+		std::cout << std::endl;
+	};
+
+	printTable("REGION TYPE", duplicates.regionTypes);
+
+	if (duplicates.processes.size() > 1)
+	{
+		printTable("PROCESS", duplicates.processes);
+	}
+}
+
+void PrintText(const VmmapText& text, const VmmapArgs& args)
+{
+	const std::size_t pageSize = PagemapPageSize();
+	const int MAPPINGS_WIDTH = 8;
+	const int VIRTUAL_WIDTH = 9;
+	const int RESIDENT_WIDTH = 9;
+	const int TOUCHED_WIDTH = 9;
+
+	std::string hugePage = (text.hugePageSize >= 1024 * 1024)
+		? std::to_string(text.hugePageSize / (1024 * 1024)) + "M"
+		: std::to_string(text.hugePageSize / 1024) + "K";
+	const int SPANS_WIDTH = std::max<int>(8, hugePage.size() + 6);
+	const int ALIGNED_WIDTH = std::max<int>(9, hugePage.size() + 6);
+
+	VmmapTextLibrary total;
+	for (const auto& library : text.libraries)
+	{
+		total.mappings += library.mappings;
+		total.vsize += library.vsize;
+		total.rss += library.rss;
+		total.hugeAligned += library.hugeAligned;
+		total.touchedPages += library.touchedPages;
+		total.touchedSpans += library.touchedSpans;
+	}
+
+	std::cout << "==== Code footprint (__TEXT) of " << text.processes << ((text.processes > 1) ? " processes" : " process") << std::endl;
+	std::cout	<< "Total: mappings=" << total.mappings << " "
+				<< "virtual=" << FormatData(total.vsize, "") << " "
+				<< "resident=" << FormatData(total.rss, "") << " "
+				<< hugePage << " aligned=" << FormatData(total.hugeAligned, "") << "(" << Percent(total.hugeAligned, std::max<std::size_t>(total.vsize, 1)) << ") "
+				<< "iTLB entries to cover touched code: " << total.touchedPages << " at " << pageSize / 1024 << "K, " << total.touchedSpans << " at " << hugePage
+				<< std::endl;
+	std::cout << std::endl;
+
+	// TOUCHED and SPANS count distinct pages over all processes, the rest is summed.
+	std::cout	<< std::right << std::setw(MAPPINGS_WIDTH) << "MAPPINGS" << " "
+				<< std::right << std::setw(VIRTUAL_WIDTH) << "VIRTUAL" << " "
+				<< std::right << std::setw(RESIDENT_WIDTH) << "RESIDENT" << " "
+				<< std::right << std::setw(TOUCHED_WIDTH) << "TOUCHED" << " "
+				<< std::right << std::setw(SPANS_WIDTH) << hugePage + " SPANS" << " "
+				<< std::right << std::setw(ALIGNED_WIDTH) << hugePage + " ALIGN" << " "
+				<< std::left << "BINARY"
+				<< std::endl;
+	std::cout	<< std::right << std::setw(MAPPINGS_WIDTH) << "========" << " "
+				<< std::right << std::setw(VIRTUAL_WIDTH) << "=======" << " "
+				<< std::right << std::setw(RESIDENT_WIDTH) << "========" << " "
+				<< std::right << std::setw(TOUCHED_WIDTH) << "=======" << " "
+				<< std::right << std::setw(SPANS_WIDTH) << "========" << " "
+				<< std::right << std::setw(ALIGNED_WIDTH) << "========" << " "
+				<< std::left << "======"
+				<< std::endl;
+
+	for (const auto& library : text.libraries)
+	{
+		std::cout	<< std::right << std::setw(MAPPINGS_WIDTH) << library.mappings << " "
+					<< std::right << std::setw(VIRTUAL_WIDTH) << PagesOrKilobytes(library.vsize, pageSize, args.pages) << " "
+					<< std::right << std::setw(RESIDENT_WIDTH) << PagesOrKilobytes(library.rss, pageSize, args.pages) << " "
+					<< std::right << std::setw(TOUCHED_WIDTH) << PagesOrKilobytes(library.touchedPages * pageSize, pageSize, args.pages) << " "
+					<< std::right << std::setw(SPANS_WIDTH) << library.touchedSpans << " "
+					<< std::right << std::setw(ALIGNED_WIDTH) << PagesOrKilobytes(library.hugeAligned, pageSize, args.pages) << " "
+					<< std::left << library.path
+					<< std::endl;
+	}
+
+	std::cout << std::endl;
+}
+
+static void PrintNumaThreads(const std::list<VmmapEntry>& entries, const VmmapArgs& args, const VmmapSnapshot& snapshot)
+{
+	std::size_t nodeCount = entries.front().nodeBytes.size();
+	std::vector<intptr_t> nodeTotals(nodeCount);
+	intptr_t total = 0;
+
+	for (const auto & entry : entries)
+	{
+		for (std::size_t node = 0; node < nodeCount; ++node)
+		{
+			nodeTotals[node] += entry.nodeBytes[node];
+			total += entry.nodeBytes[node];
+		}
+	}
+
+	std::cout << "==== NUMA placement for process " << args.pid << std::endl;
+	std::cout << "Resident:";
+	for (std::size_t node = 0; node < nodeCount; ++node)
+	{
+		std::cout << " N" << node << "=" << FormatData(nodeTotals[node], "") << "(" << Percent(nodeTotals[node], std::max<intptr_t>(total, 1)) << ")";
+	}
+	std::cout << std::endl << std::endl;
+
+	// Every thread against the memory of the whole process: threads share the
+	// address space, so local is what is on the node it runs on.
+	const int TID_WIDTH = 8;
+	const int NAME_WIDTH = 16;
+	const int CPU_WIDTH = 4;
+	const int NODE_WIDTH = 4;
+	const int LOCAL_WIDTH = 9;
+	const int PERCENT_WIDTH = 7;
+
+	std::cout	<< std::right << std::setw(TID_WIDTH) << "TID" << " "
+				<< std::left << std::setw(NAME_WIDTH) << "NAME" << " "
+				<< std::right << std::setw(CPU_WIDTH) << "CPU" << " "
+				<< std::right << std::setw(NODE_WIDTH) << "NODE" << " "
+				<< std::right << std::setw(LOCAL_WIDTH) << "LOCAL" << " "
+				<< std::right << std::setw(PERCENT_WIDTH) << "% LOCAL"
+				<< std::endl;
+	std::cout	<< std::right << std::setw(TID_WIDTH) << "===" << " "
+				<< std::left << std::setw(NAME_WIDTH) << "====" << " "
+				<< std::right << std::setw(CPU_WIDTH) << "===" << " "
+				<< std::right << std::setw(NODE_WIDTH) << "====" << " "
+				<< std::right << std::setw(LOCAL_WIDTH) << "=====" << " "
+				<< std::right << std::setw(PERCENT_WIDTH) << "======="
+				<< std::endl;
+
+	for (const auto & thread : snapshot.threads)
+	{
+		bool known = thread.node >= 0 && thread.node < (int)nodeCount;
+		intptr_t local = known ? nodeTotals[thread.node] : 0;
+
+		std::cout	<< std::right << std::setw(TID_WIDTH) << thread.tid << " "
+					<< std::left << std::setw(NAME_WIDTH) << thread.name << " "
+					<< std::right << std::setw(CPU_WIDTH) << thread.cpu << " "
+					<< std::right << std::setw(NODE_WIDTH) << (known ? std::to_string(thread.node) : std::string("?")) << " "
+					<< std::right << std::setw(LOCAL_WIDTH) << (known ? PagesOrKilobytes(local, PagemapPageSize(), args.pages) : std::string("-")) << " "
+					<< std::right << std::setw(PERCENT_WIDTH) << (known ? Percent(local, std::max<intptr_t>(total, 1)) : std::string("-"))
+					<< std::endl;
+	}
+
+	std::cout << std::endl;
+}
+
+static void PrintPageCache(const std::list<VmmapEntry>& entries, const VmmapArgs& args)
+{
+	struct CachedFile
+	{
+		std::string path;
+		intptr_t mapped = 0;
+		intptr_t cached = 0;
+		intptr_t resident = 0;
+		bool known = true;
+		std::set<std::pair<std::uint64_t, std::size_t>> ranges;
+	};
+
+	std::map<std::pair<std::string, std::uint64_t>, CachedFile> files;
+
+	for (const auto & entry : entries)
+	{
+		if (entry.inode == 0 || entry.regionDetail.find("/") == std::string::npos)
+		{
+			continue;
+		}
+
+		CachedFile& file = files[{ entry.device, entry.inode }];
+		file.path = entry.regionDetail;
+		file.resident += entry.rss;
+		file.known = file.known && entry.cacheKnown;
+
+		// The same range mapped twice is still the same pages.
+		if (file.ranges.insert({ entry.offset, entry.vsize }).second)
+		{
+			file.mapped += entry.vsize;
+			file.cached += entry.cachedBytes;
+		}
+	}
+
+	std::vector<const CachedFile*> sorted;
+	for (const auto & file : files)
+	{
+		sorted.push_back(&file.second);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const CachedFile* a, const CachedFile* b)
+	{
+		return a->cached > b->cached;
+	});
+
+	const int MAPPED_WIDTH = 9;
+	const int CACHED_WIDTH = 9;
+	const int PERCENT_WIDTH = 8;
+	const int RESIDENT_WIDTH = 9;
+	const std::size_t pageSize = PagemapPageSize();
+
+	std::cout << "==== Page cache of mapped files for process " << args.pid << std::endl;
+	std::cout	<< std::right << std::setw(MAPPED_WIDTH) << "MAPPED" << " "
+				<< std::right << std::setw(CACHED_WIDTH) << "CACHED" << " "
+				<< std::right << std::setw(PERCENT_WIDTH) << "% CACHED" << " "
+				<< std::right << std::setw(RESIDENT_WIDTH) << "RESIDENT" << " "
+				<< std::left << "FILE"
+				<< std::endl;
+	std::cout	<< std::right << std::setw(MAPPED_WIDTH) << "======" << " "
+				<< std::right << std::setw(CACHED_WIDTH) << "======" << " "
+				<< std::right << std::setw(PERCENT_WIDTH) << "========" << " "
+				<< std::right << std::setw(RESIDENT_WIDTH) << "========" << " "
+				<< std::left << "===="
+				<< std::endl;
+
+	std::size_t unknown = 0;
+	for (const auto file : sorted)
+	{
+		unknown += !file->known;
+		std::cout	<< std::right << std::setw(MAPPED_WIDTH) << PagesOrKilobytes(file->mapped, pageSize, args.pages) << " "
+					<< std::right << std::setw(CACHED_WIDTH) << (file->known ? PagesOrKilobytes(file->cached, pageSize, args.pages) : std::string("???")) << " "
+					<< std::right << std::setw(PERCENT_WIDTH) << (file->known ? Percent(file->cached, std::max<intptr_t>(file->mapped, 1)) : std::string("???")) << " "
+					<< std::right << std::setw(RESIDENT_WIDTH) << PagesOrKilobytes(file->resident, pageSize, args.pages) << " "
+					<< std::left << file->path
+					<< std::endl;
+	}
+
+	if (unknown != 0)
+	{
+		std::cout	<< "Warning: " << unknown << " file(s) could not be queried, shown as ???: mincore() only reports"
+					<< " the page cache of files that vmmap owns or may write to, unless it runs as root."
+					<< std::endl;
+	}
+
+	std::cout << std::endl;
+}
+
+static void PrintThreadStacks(const std::list<VmmapEntry>& entries, const VmmapArgs& args, const VmmapSnapshot& snapshot)
+{
+	std::map<int, const VmmapEntry*> stacks;
+	intptr_t reserved = 0;
+	intptr_t touched = 0;
+	intptr_t deepest = 0;
+	for (const auto & entry : entries)
+	{
+		if (entry.stackThread != 0)
+		{
+			stacks[entry.stackThread] = &entry;
+			reserved += entry.vsize;
+			touched += entry.stackTouchedBytes;
+			deepest = std::max<intptr_t>(deepest, entry.stackTouchedBytes);
+		}
+	}
+
+	std::cout << "==== Thread stacks for process " << args.pid << std::endl;
+	std::cout	<< "Total: threads=" << snapshot.threads.size() << " "
+				<< "found=" << stacks.size() << " "
+				<< "reserved=" << FormatData(reserved, "") << " "
+				<< "touched=" << FormatData(touched, "") << "(" << Percent(touched, std::max<intptr_t>(reserved, 1)) << ") "
+				<< "deepest=" << FormatData(deepest, "")
+				<< std::endl;
+	std::cout << std::endl;
+
+	// Threads that were running have no stack pointer, and no stack.
+	const int TID_WIDTH = 8;
+	const int NAME_WIDTH = 16;
+	const int RESERVED_WIDTH = 9;
+	const int TOUCHED_WIDTH = 9;
+	const int PERCENT_WIDTH = 6;
+
+	std::cout	<< std::right << std::setw(TID_WIDTH) << "TID" << " "
+				<< std::left << std::setw(NAME_WIDTH) << "NAME" << " "
+				<< std::right << std::setw(RESERVED_WIDTH) << "RESERVED" << " "
+				<< std::right << std::setw(TOUCHED_WIDTH) << "TOUCHED" << " "
+				<< std::right << std::setw(PERCENT_WIDTH) << "% USED"
+				<< std::endl;
+	std::cout	<< std::right << std::setw(TID_WIDTH) << "===" << " "
+				<< std::left << std::setw(NAME_WIDTH) << "====" << " "
+				<< std::right << std::setw(RESERVED_WIDTH) << "========" << " "
+				<< std::right << std::setw(TOUCHED_WIDTH) << "=======" << " "
+				<< std::right << std::setw(PERCENT_WIDTH) << "======"
+				<< std::endl;
+
+	for (const auto & thread : snapshot.threads)
+	{
+		auto it = stacks.find(thread.tid);
+		const VmmapEntry* stack = (it != stacks.end()) ? it->second : nullptr;
+
+		std::cout	<< std::right << std::setw(TID_WIDTH) << thread.tid << " "
+					<< std::left << std::setw(NAME_WIDTH) << thread.name << " "
+					<< std::right << std::setw(RESERVED_WIDTH) << (stack ? PagesOrKilobytes(stack->vsize, PagemapPageSize(), args.pages) : std::string("-")) << " "
+					<< std::right << std::setw(TOUCHED_WIDTH) << (stack ? PagesOrKilobytes(stack->stackTouchedBytes, PagemapPageSize(), args.pages) : std::string("-")) << " "
+					<< std::right << std::setw(PERCENT_WIDTH) << (stack ? Percent(stack->stackTouchedBytes, std::max<std::size_t>(stack->vsize, 1)) : std::string("-"))
+					<< std::endl;
+	}
+
+	std::cout << std::endl;
+}
+
+static void PrintFragmentation(const std::list<VmmapEntry>& entries, const VmmapArgs& args)
+{
+	VmmapFragmentation fragmentation = AnalyzeFragmentation(entries);
+	const std::size_t largest = fragmentation.largestHoles.empty() ? 0 : fragmentation.largestHoles.front().size;
+
+	std::cout << "==== Address space fragmentation for process " << args.pid << " (" << fragmentation.addressBits << "-bit)" << std::endl;
+	std::cout	<< "Total: regions=" << fragmentation.regions << " "
+				<< "mapped=" << FormatData(fragmentation.mapped, "") << " "
+				<< "holes=" << fragmentation.holes << " "
+				<< "free=" << FormatData(fragmentation.unmapped, "") << " "
+				<< "largest hole=" << FormatData(largest, "") << "(" << Percent((double)largest, std::max<double>(fragmentation.unmapped, 1)) << " of free)"
+				<< std::endl;
+	// Guards are next to stacks and heaps, reservations anywhere else.
+	std::cout	<< "Inaccessible (---p): "
+				<< "guards=" << fragmentation.guards << "(" << FormatData(fragmentation.guardBytes, "") << ") "
+				<< "reservations=" << fragmentation.reservations << "(" << FormatData(fragmentation.reservedBytes, "") << ")"
+				<< std::endl;
+
+	std::cout << "Largest holes:";
+	for (const auto& hole : fragmentation.largestHoles)
+	{
+		std::cout << " " << std::hex << hole.start << std::dec << "(" << FormatData(hole.size, "") << ")";
+	}
+	std::cout << std::endl << std::endl;
+
+	// Every row counts the sizes from 2^bucket up to 2^(bucket + 1).
+	const int BUCKET_WIDTH = 8;
+	const int COUNT_WIDTH = 8;
+
+	std::cout	<< std::right << std::setw(BUCKET_WIDTH) << "SIZE >=" << " "
+				<< std::right << std::setw(COUNT_WIDTH) << "REGIONS" << " "
+				<< std::right << std::setw(COUNT_WIDTH) << "HOLES"
+				<< std::endl;
+	std::cout	<< std::right << std::setw(BUCKET_WIDTH) << "=======" << " "
+				<< std::right << std::setw(COUNT_WIDTH) << "=======" << " "
+				<< std::right << std::setw(COUNT_WIDTH) << "====="
+				<< std::endl;
+
+	std::size_t buckets = std::max(fragmentation.regionSizes.size(), fragmentation.holeSizes.size());
+	for (std::size_t bucket = 0; bucket < buckets; ++bucket)
+	{
+		std::size_t regions = (bucket < fragmentation.regionSizes.size()) ? fragmentation.regionSizes[bucket] : 0;
+		std::size_t holes = (bucket < fragmentation.holeSizes.size()) ? fragmentation.holeSizes[bucket] : 0;
+		if (regions == 0 && holes == 0)
+		{
+			continue;
+		}
+
+		std::cout	<< std::right << std::setw(BUCKET_WIDTH) << FormatData((std::intptr_t)1 << bucket, "") << " "
+					<< std::right << std::setw(COUNT_WIDTH) << regions << " "
+					<< std::right << std::setw(COUNT_WIDTH) << holes
+					<< std::endl;
+	}
+
 	std::cout << std::endl;
 }
\ No newline at end of file
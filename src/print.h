@@ -27,8 +27,15 @@
 
 struct VmmapEntry;
 struct VmmapArgs;
+struct VmmapSnapshot;
+struct VmmapFamily;
+struct VmmapDuplicates;
+struct VmmapText;
 
 void PrintHelp();
-void Print(const std::list<VmmapEntry>& entries, const VmmapArgs& args);
+void Print(const std::list<VmmapEntry>& entries, const VmmapArgs& args, const VmmapSnapshot& snapshot);
+void PrintFamily(const VmmapFamily& family, const VmmapArgs& args);
+void PrintDuplicates(const VmmapDuplicates& duplicates, const VmmapArgs& args);
+void PrintText(const VmmapText& text, const VmmapArgs& args);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,177 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "map.h"
+#include "pagemap.h"
+#include "sharing.h"
+
+// kpageflags bit for the shared zero page.
+static const std::uint64_t KpfZeroPage = 1ull << 24;
+
+// Entries read per pread() from kpagecount and kpageflags.
+static const std::size_t WindowEntries = 64 * 1024;
+
+// Reads count 64 bit entries starting at index, returns how many could be read.
+static std::size_t ReadWindow(int fd, std::uint64_t* buffer, std::uint64_t index, std::size_t count)
+{
+	std::size_t bytes = count * sizeof(std::uint64_t);
+	std::size_t done = 0;
+
+	while (done < bytes)
+	{
+		ssize_t result = pread(fd, (char*)buffer + done, bytes - done, index * sizeof(std::uint64_t) + done);
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result <= 0)
+		{
+			break;
+		}
+		done += result;
+	}
+
+	return done / sizeof(std::uint64_t);
+}
+
+bool ReadPreciseSharing(int pid, std::list<VmmapEntry>& entries)
+{
+	std::vector<VmmapEntry*> regions;
+	std::vector<const VmmapEntry*> constRegions;
+	for (auto& entry : entries)
+	{
+		regions.push_back(&entry);
+		constRegions.push_back(&entry);
+	}
+
+	// Sorted, so that kpagecount and kpageflags are read front to back, once.
+	std::vector<PfnKey> keys;
+	if (!CollectPfns(pid, constRegions, keys))
+	{
+		return false;
+	}
+
+	int countFd = open("/proc/kpagecount", O_RDONLY);
+	int flagsFd = open("/proc/kpageflags", O_RDONLY);
+	if (countFd < 0)
+	{
+		if (flagsFd >= 0)
+		{
+			close(flagsFd);
+		}
+		return false;
+	}
+
+	std::unique_ptr<std::uint64_t[]> counts(new std::uint64_t[WindowEntries]);
+	std::unique_ptr<std::uint64_t[]> flags(new std::uint64_t[WindowEntries]);
+
+	std::vector<std::size_t> zeroPages(regions.size());
+
+	std::uint64_t windowStart = 0;
+	std::size_t windowSize = 0;
+	std::size_t flagsSize = 0;
+
+	for (PfnKey key : keys)
+	{
+		std::uint64_t pfn = PfnKeyPfn(key);
+		std::size_t index = PfnKeyRegion(key);
+
+		if (pfn < windowStart || pfn >= windowStart + windowSize)
+		{
+			windowStart = pfn;
+			windowSize = ReadWindow(countFd, counts.get(), windowStart, WindowEntries);
+			flagsSize = (flagsFd >= 0) ? ReadWindow(flagsFd, flags.get(), windowStart, WindowEntries) : 0;
+
+			if (windowSize == 0)
+			{
+				DEBUG_PRINT("PFN out of range of kpagecount.");
+				windowSize = 1;
+				counts[0] = 1;
+			}
+		}
+
+		std::size_t offset = pfn - windowStart;
+		VmmapEntry& region = *regions[index];
+
+		if (offset < flagsSize && (flags[offset] & KpfZeroPage))
+		{
+			++zeroPages[index];
+		}
+		else if (counts[offset] > 1)
+		{
+			++region.sharedPages;
+		}
+		else
+		{
+			++region.privatePages;
+		}
+	}
+
+	close(countFd);
+	if (flagsFd >= 0)
+	{
+		close(flagsFd);
+	}
+
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		VmmapEntry& region = *regions[i];
+
+		// Aliases are already as precise as they get.
+		if (region.shrmod == "S/A" || region.shrmod == "ALI")
+		{
+			continue;
+		}
+
+		if (region.sharedPages + region.privatePages == 0)
+		{
+			if (zeroPages[i] != 0)
+			{
+				region.shrmod = "ZER";
+			}
+			continue;
+		}
+
+		if (region.sharedMapping)
+		{
+			region.shrmod = region.sharedPages ? "SHM" : "PRV";
+		}
+		else
+		{
+			region.shrmod = region.sharedPages ? "COW" : "PRV";
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
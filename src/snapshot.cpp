@@ -0,0 +1,632 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "debug.h"
+#include "map.h"
+#include "snapshot.h"
+
+// How a target is stopped for -forkCorpse.
+// Mach corpses do not exist here, so we get the same guarantee (nothing in
+// the address space changes while we look at it) by freezing the target,
+// either through its cgroup v2 freezer or through SIGSTOP.
+struct Freezer
+{
+	int pid = -1;
+
+	// Set when the cgroup freezer is used.
+	int cgroupFreezeFd = -1;
+	int cgroupEventsFd = -1;
+
+	// Set when signals are used. The stat file of every thread, as each one
+	// stops on its own once the group stop reaches it.
+	std::vector<int> statFds;
+	bool wasStopped = false;
+};
+
+// The procfs files of one thread, captured along with the others.
+struct ThreadFiles
+{
+	int tid = 0;
+	VmmapSnapshotFile stat;
+	VmmapSnapshotFile syscall;
+};
+
+static const std::size_t MinimumBufferSize = 64 * 1024;
+// stat and syscall of a thread are a few hundred bytes.
+static const std::size_t ThreadBufferSize = 4 * 1024;
+static const int MaxFreezeAttempts = 3;
+static const auto FreezeTimeout = std::chrono::seconds(1);
+
+static std::string ReadSmallFile(const std::string& path)
+{
+	std::ifstream file(path);
+	std::string contents;
+	std::getline(file, contents, '\0');
+	return contents;
+}
+
+static std::string GetCgroup(int pid)
+{
+	// cgroup v2 only has one line, in the form of "0::/path".
+	std::ifstream file("/proc/" + std::to_string(pid) + "/cgroup");
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.compare(0, 3, "0::") == 0)
+		{
+			return line.substr(3);
+		}
+	}
+	return "";
+}
+
+static bool PrepareCgroupFreezer(int pid, Freezer& freezer)
+{
+	std::string cgroup = GetCgroup(pid);
+	std::string ourCgroup = GetCgroup(getpid());
+
+	if (cgroup.empty() || cgroup == "/")
+	{
+		return false;
+	}
+
+	// Never freeze ourselves.
+	if (ourCgroup == cgroup || ourCgroup.compare(0, cgroup.size() + 1, cgroup + "/") == 0)
+	{
+		return false;
+	}
+
+	std::string directory = SystemPrefix + "/sys/fs/cgroup" + cgroup;
+
+	// The freezer works on the whole cgroup. Only use it when the target
+	// is alone in there, we don't want to stop a whole service for one process.
+	std::ifstream procs(directory + "/cgroup.procs");
+	if (!procs.is_open())
+	{
+		return false;
+	}
+
+	int member;
+	bool found = false;
+	while (procs >> member)
+	{
+		if (member != pid)
+		{
+			return false;
+		}
+		found = true;
+	}
+
+	if (!found)
+	{
+		return false;
+	}
+
+	// Someone else froze it, leave it alone.
+	if (ReadSmallFile(directory + "/cgroup.freeze").compare(0, 1, "0") != 0)
+	{
+		return false;
+	}
+
+	freezer.cgroupFreezeFd = open((directory + "/cgroup.freeze").c_str(), O_WRONLY);
+	freezer.cgroupEventsFd = open((directory + "/cgroup.events").c_str(), O_RDONLY);
+
+	if (freezer.cgroupFreezeFd < 0 || freezer.cgroupEventsFd < 0)
+	{
+		if (freezer.cgroupFreezeFd >= 0)
+		{
+			close(freezer.cgroupFreezeFd);
+		}
+		if (freezer.cgroupEventsFd >= 0)
+		{
+			close(freezer.cgroupEventsFd);
+		}
+		freezer.cgroupFreezeFd = freezer.cgroupEventsFd = -1;
+		return false;
+	}
+
+	return true;
+}
+
+// Everything below, up to Thaw(), runs while the target may be stopped.
+// These functions must not allocate or parse more than a few bytes.
+
+static char ReadProcessState(int statFd)
+{
+	char buffer[512];
+	ssize_t size = pread(statFd, buffer, sizeof(buffer) - 1, 0);
+	if (size <= 0)
+	{
+		return '?';
+	}
+	buffer[size] = '\0';
+
+	// The state comes after the command name, which may contain anything.
+	const char* end = strrchr(buffer, ')');
+	if (end == nullptr || end[1] == '\0')
+	{
+		return '?';
+	}
+	return end[2];
+}
+
+static bool IsCgroupFrozen(int eventsFd)
+{
+	char buffer[256];
+	ssize_t size = pread(eventsFd, buffer, sizeof(buffer) - 1, 0);
+	if (size <= 0)
+	{
+		return false;
+	}
+	buffer[size] = '\0';
+	return strstr(buffer, "frozen 1") != nullptr;
+}
+
+static bool IsFrozen(const Freezer& freezer)
+{
+	if (freezer.cgroupFreezeFd >= 0)
+	{
+		return IsCgroupFrozen(freezer.cgroupEventsFd);
+	}
+
+	for (int statFd : freezer.statFds)
+	{
+		// Threads that exited, or are exiting, will not run again either.
+		char state = ReadProcessState(statFd);
+		if (state != 'T' && state != 't' && state != 'Z' && state != 'X' && state != '?')
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool Freeze(Freezer& freezer)
+{
+	if (freezer.cgroupFreezeFd >= 0)
+	{
+		if (pwrite(freezer.cgroupFreezeFd, "1", 1, 0) != 1)
+		{
+			return false;
+		}
+	}
+	else if (!freezer.wasStopped && kill(freezer.pid, SIGSTOP) != 0)
+	{
+		return false;
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + FreezeTimeout;
+	while (!IsFrozen(freezer))
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+		{
+			return false;
+		}
+		usleep(50);
+	}
+
+	return true;
+}
+
+static void Thaw(const Freezer& freezer)
+{
+	if (freezer.cgroupFreezeFd >= 0)
+	{
+		if (pwrite(freezer.cgroupFreezeFd, "0", 1, 0) != 1)
+		{
+			DEBUG_PRINT("Failed to thaw cgroup.");
+		}
+	}
+	else if (!freezer.wasStopped)
+	{
+		// Signals carry no owner: if a shell or debugger stopped the target
+		// while we held it, this SIGCONT resumes it as well.
+		kill(freezer.pid, SIGCONT);
+	}
+}
+
+static void ReadInto(VmmapSnapshotFile& file)
+{
+	file.size = 0;
+	file.truncated = false;
+
+	int fd = open(file.path.c_str(), O_RDONLY);
+	file.present = fd >= 0;
+	if (!file.present)
+	{
+		return;
+	}
+
+	while (true)
+	{
+		if (file.size == file.buffer.size())
+		{
+			// May be a false positive if the file ends exactly here,
+			// that only costs us one more attempt.
+			file.truncated = true;
+			break;
+		}
+
+		ssize_t count = read(fd, file.buffer.data() + file.size, file.buffer.size() - file.size);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (count <= 0)
+		{
+			break;
+		}
+		file.size += count;
+	}
+
+	close(fd);
+}
+
+// End of the no-allocation zone.
+
+static void ReadGrowing(VmmapSnapshotFile& file, std::size_t initialSize = MinimumBufferSize)
+{
+	if (file.buffer.size() < initialSize)
+	{
+		file.buffer.resize(initialSize);
+	}
+
+	ReadInto(file);
+	while (file.truncated)
+	{
+		file.buffer.resize(file.buffer.size() * 2);
+		ReadInto(file);
+	}
+}
+
+static void ReleaseFreezer(Freezer& freezer)
+{
+	for (int fd : { freezer.cgroupFreezeFd, freezer.cgroupEventsFd })
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+	for (int fd : freezer.statFds)
+	{
+		close(fd);
+	}
+	freezer.statFds.clear();
+}
+
+static std::vector<int> ListThreads(const std::string& procDirectory)
+{
+	std::vector<int> tids;
+
+	std::string taskDirectory = procDirectory + "/task";
+	DIR* dir = opendir(taskDirectory.c_str());
+	if (dir == nullptr)
+	{
+		DEBUG_PRINT("Failed to open " << taskDirectory);
+		return tids;
+	}
+
+	while (dirent* item = readdir(dir))
+	{
+		if (isdigit(item->d_name[0]))
+		{
+			tids.push_back(std::stoi(item->d_name));
+		}
+	}
+
+	closedir(dir);
+
+	std::sort(tids.begin(), tids.end());
+	return tids;
+}
+
+static void ParseThread(const ThreadFiles& files, std::vector<VmmapThread>& threads)
+{
+	// The thread exited before the capture.
+	if (!files.stat.present)
+	{
+		return;
+	}
+
+	std::string stat = files.stat.Contents();
+
+	// The name may contain anything, including spaces and parentheses.
+	std::size_t open = stat.find('(');
+	std::size_t close = stat.rfind(')');
+	if (open == std::string::npos || close == std::string::npos || close < open)
+	{
+		return;
+	}
+
+	VmmapThread thread;
+	thread.tid = files.tid;
+	thread.name = stat.substr(open + 1, close - open - 1);
+
+	// Fields after the name start at 3 (state). kstkesp is field 29, the
+	// CPU is field 39.
+	std::istringstream fields(stat.substr(close + 1));
+	std::string field;
+	for (int index = 3; fields >> field; ++index)
+	{
+		if (index == 29)
+		{
+			thread.stackPointer = std::stoull(field);
+		}
+		else if (index == 39)
+		{
+			thread.cpu = std::stoi(field);
+			break;
+		}
+	}
+
+	// "nr arg1 ... arg6 sp pc" in a system call, "-1 sp pc" when blocked
+	// elsewhere, "running" otherwise.
+	std::istringstream syscall(files.syscall.Contents());
+	std::vector<std::string> words;
+	std::string word;
+	while (syscall >> word)
+	{
+		words.push_back(word);
+	}
+	if (words.size() >= 3)
+	{
+		thread.stackPointer = std::stoull(words[words.size() - 2], nullptr, 16);
+	}
+
+	threads.push_back(thread);
+}
+
+void CaptureSnapshot(int pid, const VmmapArgs& args, VmmapSnapshot& snapshot)
+{
+	std::string procDirectory = "/proc/" + std::to_string(pid);
+
+	snapshot.smaps.path = procDirectory + "/smaps";
+	snapshot.maps.path = procDirectory + "/maps";
+	snapshot.status.path = procDirectory + "/status";
+	snapshot.numaMaps.path = procDirectory + "/numa_maps";
+	snapshot.smapsRollup.path = procDirectory + "/smaps_rollup";
+	snapshot.ksmStat.path = procDirectory + "/ksm_stat";
+	snapshot.ksmMergingPages.path = procDirectory + "/ksm_merging_pages";
+	snapshot.limits.path = procDirectory + "/limits";
+	snapshot.meminfo.path = "/proc/meminfo";
+	snapshot.overcommitMemory.path = "/proc/sys/vm/overcommit_memory";
+
+	// Read everything once without stopping anything.
+	// Without -forkCorpse, this is the result. Otherwise, it tells us how large
+	// the buffers must be for the frozen read.
+	std::vector<VmmapSnapshotFile*> files;
+
+	ReadGrowing(snapshot.smaps);
+	if (snapshot.smaps.present)
+	{
+		files.push_back(&snapshot.smaps);
+	}
+	else
+	{
+		// smaps is not always present.
+		// Fallback to maps, although we'll lose quite a lot of information.
+		DEBUG_PRINT("Failed to open smaps.");
+		ReadGrowing(snapshot.maps);
+		files.push_back(&snapshot.maps);
+	}
+
+	ReadGrowing(snapshot.status);
+	if (snapshot.status.present)
+	{
+		files.push_back(&snapshot.status);
+	}
+
+	if (args.pss)
+	{
+		// Only there since Linux 4.14.
+		ReadGrowing(snapshot.smapsRollup);
+		if (snapshot.smapsRollup.present)
+		{
+			files.push_back(&snapshot.smapsRollup);
+		}
+	}
+
+	if (args.numa)
+	{
+		// Absent without CONFIG_NUMA.
+		ReadGrowing(snapshot.numaMaps);
+		if (snapshot.numaMaps.present)
+		{
+			files.push_back(&snapshot.numaMaps);
+		}
+	}
+
+	if (args.ksm)
+	{
+		for (auto file : { &snapshot.ksmStat, &snapshot.ksmMergingPages })
+		{
+			ReadGrowing(*file);
+			if (file->present)
+			{
+				files.push_back(file);
+			}
+		}
+	}
+
+	if (args.commit)
+	{
+		for (auto file : { &snapshot.limits, &snapshot.meminfo, &snapshot.overcommitMemory })
+		{
+			ReadGrowing(*file);
+			if (file->present)
+			{
+				files.push_back(file);
+			}
+		}
+	}
+
+	// For the NUMA nodes, and to find the thread stacks. Reading syscall needs
+	// the same access as the memory of the process, so the threads are only
+	// read when something uses them.
+	// Threads started after this point are not seen.
+	std::vector<ThreadFiles> threadFiles;
+	if (args.numa || args.threadStacks || args.arenas)
+	{
+		std::vector<int> tids = ListThreads(procDirectory);
+		threadFiles.resize(tids.size());
+		for (std::size_t index = 0; index < tids.size(); ++index)
+		{
+			std::string taskDirectory = procDirectory + "/task/" + std::to_string(tids[index]);
+			threadFiles[index].tid = tids[index];
+			threadFiles[index].stat.path = taskDirectory + "/stat";
+			threadFiles[index].syscall.path = taskDirectory + "/syscall";
+		}
+	}
+
+	// Buffers of the thread files are fixed, they are small and there may be
+	// thousands of them.
+	std::vector<VmmapSnapshotFile*> smallFiles;
+	for (auto& thread : threadFiles)
+	{
+		for (auto file : { &thread.stat, &thread.syscall })
+		{
+			ReadGrowing(*file, ThreadBufferSize);
+			smallFiles.push_back(file);
+		}
+	}
+
+	if (!args.forkCorpse)
+	{
+		for (const auto& thread : threadFiles)
+		{
+			ParseThread(thread, snapshot.threads);
+		}
+		return;
+	}
+
+	Freezer freezer;
+	freezer.pid = pid;
+
+	if (PrepareCgroupFreezer(pid, freezer))
+	{
+		snapshot.freezeMethod = "cgroup freezer";
+	}
+	else
+	{
+		snapshot.freezeMethod = "SIGSTOP";
+
+		// The group stop reaches every thread separately, and the leader may
+		// already be a zombie, so wait for all of them.
+		std::vector<std::string> statPaths;
+		for (int tid : ListThreads(procDirectory))
+		{
+			statPaths.push_back(procDirectory + "/task/" + std::to_string(tid) + "/stat");
+		}
+		if (statPaths.empty())
+		{
+			statPaths.push_back(procDirectory + "/stat");
+		}
+
+		for (const auto& path : statPaths)
+		{
+			int statFd = open(path.c_str(), O_RDONLY);
+			if (statFd < 0)
+			{
+				ReleaseFreezer(freezer);
+				throw std::invalid_argument("vmmap: failed to open " + path + ".");
+			}
+			freezer.statFds.push_back(statFd);
+		}
+		freezer.wasStopped = IsFrozen(freezer);
+	}
+
+	for (int attempt = 0; attempt < MaxFreezeAttempts; ++attempt)
+	{
+		// The target may map more while we are not looking, so leave some headroom.
+		for (auto file : files)
+		{
+			file->buffer.resize(std::max(file->buffer.size(), file->size + file->size / 2 + MinimumBufferSize));
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		if (!Freeze(freezer))
+		{
+			Thaw(freezer);
+			ReleaseFreezer(freezer);
+			throw std::invalid_argument("vmmap: failed to freeze process " + std::to_string(pid) + " using " + snapshot.freezeMethod + ".");
+		}
+
+		bool truncated = false;
+		for (auto list : { &files, &smallFiles })
+		{
+			for (auto file : *list)
+			{
+				ReadInto(*file);
+				truncated = truncated || file->truncated;
+			}
+		}
+
+		Thaw(freezer);
+		snapshot.freezeDuration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+		if (!truncated)
+		{
+			snapshot.frozen = true;
+			break;
+		}
+
+		for (auto list : { &files, &smallFiles })
+		{
+			for (auto file : *list)
+			{
+				file->buffer.resize(file->buffer.size() * 2);
+			}
+		}
+	}
+
+	ReleaseFreezer(freezer);
+
+	for (const auto& thread : threadFiles)
+	{
+		ParseThread(thread, snapshot.threads);
+	}
+
+	if (!snapshot.frozen)
+	{
+		throw std::invalid_argument("vmmap: the address space of process " + std::to_string(pid) + " keeps growing, failed to take a snapshot.");
+	}
+}
\ No newline at end of file
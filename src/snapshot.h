@@ -0,0 +1,112 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_SNAPSHOT_H__
+#define VMMAP_SNAPSHOT_H__
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct VmmapArgs;
+
+// A procfs file, read in one go into a buffer that is allocated
+// before the target is frozen.
+struct VmmapSnapshotFile
+{
+	std::string path;
+	std::vector<char> buffer;
+	std::size_t size = 0;
+
+	bool present = false;
+	bool truncated = false;
+
+	inline std::string Contents() const
+	{
+		return std::string(buffer.data(), size);
+	}
+};
+
+// A thread of the process, from /proc/<pid>/task/<tid>/stat.
+struct VmmapThread
+{
+	int tid = 0;
+	std::string name;
+	// The CPU it last ran on.
+	int cpu = -1;
+	// The NUMA node of that CPU, only set with -numa.
+	int node = -1;
+	// From task/<tid>/syscall, which needs the same access as the memory of
+	// the process, or the stat field the kernel only fills in core dumps.
+	// 0 if the thread was running.
+	std::uintptr_t stackPointer = 0;
+};
+
+struct VmmapSnapshot
+{
+	VmmapSnapshotFile smaps;
+	VmmapSnapshotFile maps;
+	// For the peak footprint (VmHWM).
+	VmmapSnapshotFile status;
+
+	// Only read with -pss.
+	VmmapSnapshotFile smapsRollup;
+
+	// Only read with -numa.
+	VmmapSnapshotFile numaMaps;
+
+	// Only read with -ksm. The per process counters, since Linux 6.1
+	// (ksm_stat) and 5.19 (ksm_merging_pages).
+	VmmapSnapshotFile ksmStat;
+	VmmapSnapshotFile ksmMergingPages;
+
+	// Only read with -commit: RLIMIT_MEMLOCK from the process limits, and
+	// the system wide commit charge and overcommit mode.
+	VmmapSnapshotFile limits;
+	VmmapSnapshotFile meminfo;
+	VmmapSnapshotFile overcommitMemory;
+
+	// Only read with -numa, -threadstacks and -arenas. With -forkCorpse, read
+	// while the target is frozen, so that every thread has a stack pointer.
+	std::vector<VmmapThread> threads;
+
+	// Only set with -faults: min_flt and maj_flt of the process over the
+	// interval, from /proc/<pid>/stat.
+	std::size_t minorFaults = 0;
+	std::size_t majorFaults = 0;
+
+	// Only set for -forkCorpse.
+	bool frozen = false;
+	std::string freezeMethod;
+	std::chrono::microseconds freezeDuration{0};
+};
+
+// Reads all procfs files needed by Map().
+// With -forkCorpse, the target is frozen while the files are read, so that
+// the regions form a consistent point-in-time picture of the address space.
+// Without a private cgroup, the target is frozen with SIGSTOP/SIGCONT, which
+// races with job control: a stop sent by someone else while the target is
+// frozen is undone by the SIGCONT that thaws it.
+void CaptureSnapshot(int pid, const VmmapArgs& args, VmmapSnapshot& snapshot);
+
+#endif
\ No newline at end of file
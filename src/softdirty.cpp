@@ -0,0 +1,108 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "debug.h"
+#include "map.h"
+#include "pagemap.h"
+#include "softdirty.h"
+
+// Value for clear_refs that only clears the soft-dirty bits.
+static const char ClearSoftDirty[] = "4";
+
+static bool ClearRefs(int pid)
+{
+	std::string path = "/proc/" + std::to_string(pid) + "/clear_refs";
+	int fd = open(path.c_str(), O_WRONLY);
+	if (fd < 0)
+	{
+		DEBUG_PRINT("Failed to open clear_refs.");
+		return false;
+	}
+
+	bool result = write(fd, ClearSoftDirty, sizeof(ClearSoftDirty) - 1) == sizeof(ClearSoftDirty) - 1;
+	close(fd);
+	return result;
+}
+
+bool MeasureWrites(const VmmapArgs& args, std::list<VmmapEntry>& entries)
+{
+	std::vector<VmmapEntry*> regions;
+	std::vector<const VmmapEntry*> constRegions;
+	for (auto& entry : entries)
+	{
+		if (entry.prt[WRITE_INDEX] == 'w')
+		{
+			regions.push_back(&entry);
+			constRegions.push_back(&entry);
+		}
+	}
+
+	if (!ClearRefs(args.pid))
+	{
+		return false;
+	}
+
+	std::this_thread::sleep_for(std::chrono::seconds(args.writeSeconds));
+
+	std::vector<std::atomic<std::size_t>> written(regions.size());
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		written[i] = 0;
+	}
+
+	// Swapped pages keep their soft-dirty bit, a page written and then
+	// swapped out during the interval still counts. Holes do not: the kernel
+	// sets the bit on every empty entry of a VMA that was created or grown
+	// during the interval.
+	bool result = WalkPagemap(args.pid, constRegions, [&](const PagemapBatch& batch)
+	{
+		std::size_t batchWritten = 0;
+		for (std::size_t i = 0; i < batch.count; ++i)
+		{
+			std::uint64_t entry = batch.entries[i];
+			batchWritten += (entry & PagemapSoftDirty) && (entry & (PagemapPresent | PagemapSwapped));
+		}
+		written[batch.region] += batchWritten;
+	});
+
+	if (!result)
+	{
+		return false;
+	}
+
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		regions[i]->writtenPages = written[i];
+	}
+
+	return true;
+}
\ No newline at end of file
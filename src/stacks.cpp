@@ -0,0 +1,133 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "map.h"
+#include "pagemap.h"
+#include "snapshot.h"
+#include "stacks.h"
+
+void IdentifyThreadStacks(const VmmapSnapshot& snapshot, std::list<VmmapEntry>& entries)
+{
+	// Sorted by start address, as the regions are, for the binary search.
+	std::vector<VmmapEntry*> regions;
+	for (auto& entry : entries)
+	{
+		regions.push_back(&entry);
+	}
+
+	for (const auto& thread : snapshot.threads)
+	{
+		if (thread.stackPointer == 0)
+		{
+			continue;
+		}
+
+		// The last region that starts at or below the stack pointer.
+		auto it = std::upper_bound(regions.begin(), regions.end(), thread.stackPointer, [](std::uintptr_t address, const VmmapEntry* entry)
+		{
+			return address < (std::uintptr_t)entry->startAddress;
+		});
+		if (it == regions.begin())
+		{
+			continue;
+		}
+
+		VmmapEntry& entry = **(it - 1);
+		if (thread.stackPointer >= (std::uintptr_t)entry.endAddress || entry.stackThread != 0)
+		{
+			continue;
+		}
+
+		// Signal handlers on an alternate stack, and user space threads, may
+		// run anywhere. Only plain anonymous memory is taken for a stack.
+		if (entry.regionType != "Stack" && entry.regionType != "VM_ALLOCATE")
+		{
+			continue;
+		}
+
+		entry.regionType = "Stack";
+		entry.regionDetail = "thread " + std::to_string(thread.tid) + " (" + thread.name + ")";
+		entry.stackThread = thread.tid;
+	}
+}
+
+bool MeasureStackDepth(int pid, std::list<VmmapEntry>& entries)
+{
+	std::vector<VmmapEntry*> stacks;
+	std::vector<const VmmapEntry*> constStacks;
+	for (auto& entry : entries)
+	{
+		entry.stackTouchedBytes = 0;
+		if (entry.stackThread != 0)
+		{
+			stacks.push_back(&entry);
+			constStacks.push_back(&entry);
+		}
+	}
+
+	// The lowest populated page of every stack, relative to its start.
+	std::vector<std::atomic<std::size_t>> lowest(stacks.size());
+	for (auto& page : lowest)
+	{
+		page = SIZE_MAX;
+	}
+
+	bool result = WalkPagemap(pid, constStacks, [&](const PagemapBatch& batch)
+	{
+		for (std::size_t i = 0; i < batch.count; ++i)
+		{
+			if ((batch.entries[i] & (PagemapPresent | PagemapSwapped)) == 0)
+			{
+				continue;
+			}
+
+			std::size_t page = batch.firstPage + i;
+			std::size_t current = lowest[batch.region];
+			while (page < current && !lowest[batch.region].compare_exchange_weak(current, page))
+			{
+			}
+			break;
+		}
+	});
+
+	if (!result)
+	{
+		return false;
+	}
+
+	const std::size_t pageSize = PagemapPageSize();
+	for (std::size_t i = 0; i < stacks.size(); ++i)
+	{
+		if (lowest[i] != SIZE_MAX)
+		{
+			stacks[i]->stackTouchedBytes = stacks[i]->vsize - lowest[i] * pageSize;
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_STACKS_H__
+#define VMMAP_STACKS_H__
+
+#include <list>
+
+struct VmmapEntry;
+struct VmmapSnapshot;
+
+// Labels the anonymous regions that hold the stack pointer of a thread as
+// its Stack, with the thread name in the detail, and sets
+// VmmapEntry::stackThread. Linux stopped tagging them [stack:tid] in 4.5.
+// Threads are only captured with -numa, -threadstacks and -arenas. Without
+// -forkCorpse, threads that were running at the time are not found.
+void IdentifyThreadStacks(const VmmapSnapshot& snapshot, std::list<VmmapEntry>& entries);
+
+// Fills VmmapEntry::stackTouchedBytes of the thread stacks, from the lowest
+// page in the pagemap that is present or swapped.
+// Returns false if the pagemap of the process cannot be opened.
+bool MeasureStackDepth(int pid, std::list<VmmapEntry>& entries);
+
+#endif
\ No newline at end of file
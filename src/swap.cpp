@@ -0,0 +1,133 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "map.h"
+#include "pagemap.h"
+#include "swap.h"
+
+// Swap types are 5 bits in a swap entry.
+static const std::size_t MaxSwapTypes = 32;
+
+std::string VmmapSwapDevice::ShortName() const
+{
+	std::size_t slash = path.rfind('/');
+	return (slash == std::string::npos) ? path : path.substr(slash + 1);
+}
+
+std::vector<VmmapSwapDevice> ReadSwapDevices()
+{
+	std::vector<VmmapSwapDevice> devices;
+	std::ifstream file("/proc/swaps");
+	std::string line;
+
+	// Filename Type Size Used Priority
+	std::getline(file, line);
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line);
+		VmmapSwapDevice device;
+		std::string type;
+		if (!(fields >> device.path >> type))
+		{
+			continue;
+		}
+
+		// zram is a block device, only its name tells it apart from a disk.
+		device.kind = (device.ShortName().compare(0, 4, "zram") == 0) ? "zram" : "disk";
+		devices.push_back(device);
+	}
+
+	return devices;
+}
+
+bool ReadSwapPlacement(int pid, std::list<VmmapEntry>& entries)
+{
+	const std::size_t pageSize = PagemapPageSize();
+	std::size_t deviceCount = ReadSwapDevices().size();
+
+	std::vector<VmmapEntry*> regions;
+	std::vector<const VmmapEntry*> constRegions;
+	for (auto& entry : entries)
+	{
+		entry.swapDeviceBytes.assign(deviceCount, 0);
+
+		// Only regions with something swapped out are worth walking.
+		if (entry.swap != 0)
+		{
+			regions.push_back(&entry);
+			constRegions.push_back(&entry);
+		}
+	}
+
+	if (deviceCount == 0)
+	{
+		return true;
+	}
+
+	std::vector<std::atomic<std::size_t>> pages(regions.size() * MaxSwapTypes);
+	for (auto& count : pages)
+	{
+		count = 0;
+	}
+
+	bool result = WalkPagemap(pid, constRegions, [&](const PagemapBatch& batch)
+	{
+		std::size_t batchPages[MaxSwapTypes] = {};
+		for (std::size_t i = 0; i < batch.count; ++i)
+		{
+			std::uint64_t entry = batch.entries[i];
+			if ((entry & PagemapSwapped) && !(entry & PagemapPresent))
+			{
+				++batchPages[PagemapSwapType(entry)];
+			}
+		}
+
+		for (std::size_t type = 0; type < MaxSwapTypes; ++type)
+		{
+			if (batchPages[type] != 0)
+			{
+				pages[batch.region * MaxSwapTypes + type] += batchPages[type];
+			}
+		}
+	});
+
+	if (!result)
+	{
+		return false;
+	}
+
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		for (std::size_t type = 0; type < deviceCount && type < MaxSwapTypes; ++type)
+		{
+			regions[i]->swapDeviceBytes[type] = pages[i * MaxSwapTypes + type] * pageSize;
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_SWAP_H__
+#define VMMAP_SWAP_H__
+
+#include <list>
+#include <string>
+#include <vector>
+
+struct VmmapEntry;
+
+// A swap area, from /proc/swaps.
+struct VmmapSwapDevice
+{
+	std::string path;
+	// "zram" for compressed RAM, "disk" for partitions and files.
+	std::string kind;
+
+	// For column headers, "zram0" for /dev/zram0.
+	std::string ShortName() const;
+};
+
+// Swap areas in the order of /proc/swaps, which lists them by swap type, the
+// index stored in swap entries. If an area was removed with swapoff and its
+// slot not reused, later areas are off by one; the kernel does not tell.
+std::vector<VmmapSwapDevice> ReadSwapDevices();
+
+// Fills VmmapEntry::swapDeviceBytes from the swap type of every swapped page
+// in the pagemap, indexed like ReadSwapDevices().
+// Returns false if the pagemap of the process cannot be opened.
+bool ReadSwapPlacement(int pid, std::list<VmmapEntry>& entries);
+
+#endif
\ No newline at end of file
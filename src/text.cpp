@@ -0,0 +1,174 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "hugepages.h"
+#include "map.h"
+#include "pagemap.h"
+#include "text.h"
+
+struct LibraryPages
+{
+	VmmapTextLibrary library;
+	// One bit per page of the file.
+	std::vector<std::uint64_t> touched;
+	int lastProcess = -1;
+};
+
+static std::size_t HugeAlignedBytes(const VmmapEntry& entry, std::uint64_t hugePageSize)
+{
+	std::uint64_t start = entry.startAddress;
+	std::uint64_t end = entry.endAddress;
+
+	// The address and the file offset must be equal modulo the huge page size
+	// (2M on x86-64) for a huge page to map that much of the file, which is
+	// what relinking with -z max-page-size=2M (or common-page-size) gets right.
+	if ((start - entry.offset) % hugePageSize != 0)
+	{
+		return 0;
+	}
+
+	std::uint64_t alignedStart = (start + hugePageSize - 1) & ~(hugePageSize - 1);
+	std::uint64_t alignedEnd = end & ~(hugePageSize - 1);
+	return (alignedEnd > alignedStart) ? alignedEnd - alignedStart : 0;
+}
+
+bool AnalyzeText(const std::vector<VmmapProcess>& processes, VmmapText& text)
+{
+	const std::size_t pageSize = PagemapPageSize();
+	text.hugePageSize = ReadPmdSize();
+	std::map<std::string, LibraryPages> libraries;
+
+	for (std::size_t process = 0; process < processes.size(); ++process)
+	{
+		std::vector<const VmmapEntry*> regions;
+		std::vector<LibraryPages*> owners;
+
+		for (const auto& entry : processes[process].entries)
+		{
+			if (entry.regionType != "__TEXT")
+			{
+				continue;
+			}
+
+			LibraryPages& pages = libraries[entry.regionDetail];
+			pages.library.path = entry.regionDetail;
+			pages.library.mappings++;
+			pages.library.vsize += entry.vsize;
+			pages.library.rss += entry.rss;
+			pages.library.hugeAligned += HugeAlignedBytes(entry, text.hugePageSize);
+			if (pages.lastProcess != (int)process)
+			{
+				pages.library.processes++;
+				pages.lastProcess = process;
+			}
+
+			std::size_t filePages = (entry.offset + entry.vsize) / pageSize;
+			if (pages.touched.size() * 64 < filePages)
+			{
+				pages.touched.resize((filePages + 63) / 64);
+			}
+
+			regions.push_back(&entry);
+			owners.push_back(&pages);
+		}
+
+		// Region-relative bitmaps can be written from the visitor without locking,
+		// they are merged into the file bitmaps afterwards.
+		std::vector<std::vector<std::uint64_t>> present(regions.size());
+		for (std::size_t i = 0; i < regions.size(); ++i)
+		{
+			present[i].resize((regions[i]->vsize / pageSize + 63) / 64);
+		}
+
+		bool result = WalkPagemap(processes[process].pid, regions, [&](const PagemapBatch& batch)
+		{
+			std::vector<std::uint64_t>& bitmap = present[batch.region];
+			for (std::size_t i = 0; i < batch.count; ++i)
+			{
+				if (batch.entries[i] & PagemapPresent)
+				{
+					std::size_t page = batch.firstPage + i;
+					bitmap[page / 64] |= 1ull << (page % 64);
+				}
+			}
+		});
+
+		if (!result)
+		{
+			return false;
+		}
+
+		for (std::size_t i = 0; i < regions.size(); ++i)
+		{
+			std::size_t firstFilePage = regions[i]->offset / pageSize;
+			std::vector<std::uint64_t>& touched = owners[i]->touched;
+
+			for (std::size_t word = 0; word < present[i].size(); ++word)
+			{
+				for (std::uint64_t bits = present[i][word]; bits != 0; bits &= bits - 1)
+				{
+					std::size_t page = firstFilePage + word * 64 + __builtin_ctzll(bits);
+					touched[page / 64] |= 1ull << (page % 64);
+				}
+			}
+		}
+	}
+
+	const std::size_t pagesPerSpan = text.hugePageSize / pageSize;
+
+	for (auto& entry : libraries)
+	{
+		LibraryPages& pages = entry.second;
+		std::size_t lastSpan = SIZE_MAX;
+
+		for (std::size_t word = 0; word < pages.touched.size(); ++word)
+		{
+			for (std::uint64_t bits = pages.touched[word]; bits != 0; bits &= bits - 1)
+			{
+				std::size_t page = word * 64 + __builtin_ctzll(bits);
+				pages.library.touchedPages++;
+
+				// Pages come in order, so a new span is a different one.
+				if (page / pagesPerSpan != lastSpan)
+				{
+					lastSpan = page / pagesPerSpan;
+					pages.library.touchedSpans++;
+				}
+			}
+		}
+
+		text.libraries.push_back(pages.library);
+	}
+
+	std::sort(text.libraries.begin(), text.libraries.end(), [](const VmmapTextLibrary& a, const VmmapTextLibrary& b)
+	{
+		return a.rss > b.rss;
+	});
+	text.processes = processes.size();
+
+	return true;
+}
\ No newline at end of file
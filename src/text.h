@@ -0,0 +1,70 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_TEXT_H__
+#define VMMAP_TEXT_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct VmmapProcess;
+
+// The __TEXT of one binary, over all processes.
+// Touched pages are counted by offset into the file, so a page of libc
+// resident in several processes counts once.
+struct VmmapTextLibrary
+{
+	std::string path;
+
+	std::size_t processes = 0;
+	std::size_t mappings = 0;
+
+	// Summed over all processes.
+	std::size_t vsize = 0;
+	std::size_t rss = 0;
+
+	// Bytes in huge-page-sized spans that a huge page could back, because the
+	// address and the file offset of the mapping are aligned to each other.
+	std::size_t hugeAligned = 0;
+
+	// Distinct resident pages of PagemapPageSize() bytes, and distinct huge
+	// page spans of the file they fall in: the iTLB entries needed to cover the
+	// code with base pages, and with huge pages.
+	std::size_t touchedPages = 0;
+	std::size_t touchedSpans = 0;
+};
+
+struct VmmapText
+{
+	// Sorted by resident code, largest first.
+	std::vector<VmmapTextLibrary> libraries;
+	std::size_t processes = 0;
+	// The PMD huge page size, see ReadPmdSize().
+	std::size_t hugePageSize = 2 * 1024 * 1024;
+};
+
+// Reads the pagemap of the __TEXT regions of every process.
+// Returns false if the pagemap of a process cannot be read.
+bool AnalyzeText(const std::vector<VmmapProcess>& processes, VmmapText& text);
+
+#endif
\ No newline at end of file
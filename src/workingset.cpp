@@ -0,0 +1,202 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cerrno>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "debug.h"
+#include "map.h"
+#include "pagemap.h"
+#include "workingset.h"
+
+// Words of the bitmap (64 PFNs each) per pread() or pwrite(). 512K of buffer.
+static const std::size_t WindowWords = 64 * 1024;
+
+// A bitmap word, and the bits of it that belong to our pages.
+struct IdleWord
+{
+	std::uint64_t index;
+	std::uint64_t mask;
+};
+
+static bool TransferWords(int fd, std::uint64_t* buffer, std::size_t count, std::uint64_t index, bool write)
+{
+	std::size_t bytes = count * sizeof(std::uint64_t);
+	off_t offset = index * sizeof(std::uint64_t);
+	std::size_t done = 0;
+
+	while (done < bytes)
+	{
+		ssize_t result = write
+			? pwrite(fd, (char*)buffer + done, bytes - done, offset + done)
+			: pread(fd, (char*)buffer + done, bytes - done, offset + done);
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result <= 0)
+		{
+			return false;
+		}
+		done += result;
+	}
+
+	return true;
+}
+
+// Visits the words in windows of consecutive bitmap words, so that the whole
+// pass is a few large sequential reads or writes. Words between ours in a
+// window are written as 0, which leaves those pages alone.
+static bool ForEachWindow(int fd, const std::vector<IdleWord>& words, bool write,
+	const std::function<void(std::size_t word, std::uint64_t bits)>& visit)
+{
+	std::vector<std::uint64_t> buffer(WindowWords);
+
+	for (std::size_t first = 0; first < words.size(); )
+	{
+		std::uint64_t start = words[first].index;
+		std::size_t last = first;
+		while (last < words.size() && words[last].index < start + WindowWords)
+		{
+			++last;
+		}
+
+		std::size_t count = words[last - 1].index - start + 1;
+
+		if (write)
+		{
+			std::fill(buffer.begin(), buffer.begin() + count, 0);
+			for (std::size_t i = first; i < last; ++i)
+			{
+				buffer[words[i].index - start] = words[i].mask;
+			}
+		}
+
+		if (!TransferWords(fd, buffer.data(), count, start, write))
+		{
+			return false;
+		}
+
+		if (!write)
+		{
+			for (std::size_t i = first; i < last; ++i)
+			{
+				visit(i, buffer[words[i].index - start]);
+			}
+		}
+
+		first = last;
+	}
+
+	return true;
+}
+
+bool MeasureWorkingSet(const VmmapArgs& args, std::list<VmmapEntry>& entries)
+{
+	std::vector<VmmapEntry*> regions;
+	std::vector<const VmmapEntry*> constRegions;
+	for (auto& entry : entries)
+	{
+		regions.push_back(&entry);
+		constRegions.push_back(&entry);
+	}
+
+	std::vector<PfnKey> keys;
+	if (!CollectPfns(args.pid, constRegions, keys))
+	{
+		return false;
+	}
+
+	std::string path = SystemPrefix + "/sys/kernel/mm/page_idle/bitmap";
+	int fd = open(path.c_str(), O_RDWR);
+	if (fd < 0)
+	{
+		DEBUG_PRINT("Failed to open page_idle/bitmap.");
+		return false;
+	}
+
+	// The keys are sorted by PFN, so the words come out sorted too.
+	std::vector<IdleWord> words;
+	for (PfnKey key : keys)
+	{
+		std::uint64_t pfn = PfnKeyPfn(key);
+		if (words.empty() || words.back().index != pfn / 64)
+		{
+			words.push_back({ pfn / 64, 0 });
+		}
+		words.back().mask |= 1ull << (pfn % 64);
+	}
+
+	auto noVisit = [](std::size_t, std::uint64_t) {};
+	if (!ForEachWindow(fd, words, true, noVisit))
+	{
+		close(fd);
+		return false;
+	}
+
+	std::this_thread::sleep_for(std::chrono::seconds(args.workingSetSeconds));
+
+	// Pages whose idle bit was cleared were accessed.
+	std::vector<std::uint64_t> idleBits(words.size());
+	bool result = ForEachWindow(fd, words, false, [&](std::size_t word, std::uint64_t bits)
+	{
+		idleBits[word] = bits;
+	});
+	close(fd);
+
+	if (!result)
+	{
+		return false;
+	}
+
+	std::size_t word = 0;
+	for (PfnKey key : keys)
+	{
+		std::uint64_t pfn = PfnKeyPfn(key);
+		while (words[word].index != pfn / 64)
+		{
+			++word;
+		}
+
+		VmmapEntry& region = *regions[PfnKeyRegion(key)];
+		if ((idleBits[word] >> (pfn % 64)) & 1)
+		{
+			++region.idlePages;
+		}
+		else
+		{
+			++region.accessedPages;
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VMMAP_WORKINGSET_H__
+#define VMMAP_WORKINGSET_H__
+
+#include <list>
+
+struct VmmapEntry;
+struct VmmapArgs;
+
+// Marks every resident page of the process idle through
+// /sys/kernel/mm/page_idle/bitmap, waits args.workingSetSeconds, and counts
+// which pages were accessed in the meantime, into VmmapEntry::accessedPages
+// and VmmapEntry::idlePages.
+// Returns false if idle page tracking is not available, or if page frame
+// numbers cannot be read.
+bool MeasureWorkingSet(const VmmapArgs& args, std::list<VmmapEntry>& entries);
+
+#endif
\ No newline at end of file
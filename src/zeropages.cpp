@@ -0,0 +1,183 @@
+// This file is a part of vmmap for Darling.
+
+// Copyright (c) 2021 Trung Nguyen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "args.h"
+#include "map.h"
+#include "memory.h"
+#include "pagemap.h"
+#include "parallel.h"
+#include "zeropages.h"
+
+// Pages read per pread(), per thread.
+static const std::size_t ReadPages = 256;
+
+static bool IsZeroScalar(const char* page, std::size_t size, std::size_t i)
+{
+	for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+	{
+		std::uint64_t word;
+		memcpy(&word, page + i, sizeof(word));
+		if (word != 0)
+		{
+			return false;
+		}
+	}
+
+	for (; i < size; ++i)
+	{
+		if (page[i] != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// OR a whole cache line together before testing, to keep the branch count low.
+// The default build does not target AVX2, so it is compiled for this function
+// only and picked at run time.
+__attribute__((target("avx2")))
+static bool IsZeroAvx2(const char* page, std::size_t size)
+{
+	std::size_t i = 0;
+	for (; i + 128 <= size; i += 128)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(page + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(page + i + 32));
+		__m256i c = _mm256_loadu_si256((const __m256i*)(page + i + 64));
+		__m256i d = _mm256_loadu_si256((const __m256i*)(page + i + 96));
+		__m256i all = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+		if (!_mm256_testz_si256(all, all))
+		{
+			return false;
+		}
+	}
+	return IsZeroScalar(page, size, i);
+}
+
+__attribute__((target("sse2")))
+static bool IsZeroSse2(const char* page, std::size_t size)
+{
+	std::size_t i = 0;
+	for (; i + 64 <= size; i += 64)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(page + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(page + i + 16));
+		__m128i c = _mm_loadu_si128((const __m128i*)(page + i + 32));
+		__m128i d = _mm_loadu_si128((const __m128i*)(page + i + 48));
+		__m128i all = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(all, _mm_setzero_si128())) != 0xffff)
+		{
+			return false;
+		}
+	}
+	return IsZeroScalar(page, size, i);
+}
+#endif
+
+bool IsZeroPage(const char* page, std::size_t size)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+	return hasAvx2 ? IsZeroAvx2(page, size) : IsZeroSse2(page, size);
+#else
+	return IsZeroScalar(page, size, 0);
+#endif
+}
+
+bool ScanZeroPages(const VmmapArgs& args, std::list<VmmapEntry>& entries)
+{
+	MemoryReader reader(args.pid, args.scanRate * 1024 * 1024);
+	if (!reader.IsOpen())
+	{
+		return false;
+	}
+
+	const std::size_t pageSize = PagemapPageSize();
+
+	std::vector<VmmapEntry*> regions;
+	std::vector<const VmmapEntry*> constRegions;
+	for (auto& entry : entries)
+	{
+		if (entry.prt[WRITE_INDEX] == 'w' && !entry.sharedMapping)
+		{
+			regions.push_back(&entry);
+			constRegions.push_back(&entry);
+		}
+	}
+
+	std::vector<std::atomic<std::size_t>> scanned(regions.size());
+	std::vector<std::atomic<std::size_t>> zero(regions.size());
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		scanned[i] = 0;
+		zero[i] = 0;
+	}
+
+	std::vector<std::vector<char>> buffers(WorkerCount());
+
+	bool result = WalkPagemap(args.pid, constRegions, [&](const PagemapBatch& batch)
+	{
+		std::vector<char>& buffer = buffers[batch.worker];
+		if (buffer.empty())
+		{
+			buffer.resize(ReadPages * pageSize);
+		}
+
+		std::size_t batchScanned = 0;
+		std::size_t batchZero = 0;
+
+		reader.ReadPages(regions[batch.region]->startAddress, batch, PagemapPresent | PagemapExclusive, 0, buffer,
+			[&](std::size_t, const char* data)
+		{
+			++batchScanned;
+			batchZero += IsZeroPage(data, pageSize);
+		});
+
+		scanned[batch.region] += batchScanned;
+		zero[batch.region] += batchZero;
+	});
+
+	if (!result)
+	{
+		return false;
+	}
+
+	for (std::size_t i = 0; i < regions.size(); ++i)
+	{
+		regions[i]->scannedPages = scanned[i];
+		regions[i]->zeroPages = zero[i];
+	}
+
+	return true;
+}
\ No newline at end of file